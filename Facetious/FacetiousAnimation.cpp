@@ -0,0 +1,140 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+//  FacetiousAnimation.cpp
+//
+
+#include "FacetiousAnimation.h"
+
+#include <cmath>
+#include <stdexcept>
+#include <stdio.h>
+
+AnimationClock::AnimationClock() :
+    _realTime(true), _scale(1.0), _step(0), _running(false), _time(0),
+    _baseTime(0)
+{
+}
+
+AnimationClock AnimationClock::parse(const std::string& spec)
+{
+    // The value must be all that follows the colon, and positive.
+
+    size_t colon = spec.find(':');
+    std::string kind = spec.substr(0, colon);
+    double value = 0;
+    char extra;
+    bool ok = (colon != std::string::npos) &&
+        (sscanf(spec.c_str() + colon + 1, "%lf%c", &value, &extra) == 1) &&
+        std::isfinite(value) && (value > 0);
+
+    AnimationClock clock;
+    std::chrono::duration<double> seconds(value);
+    if (ok && (kind == "scale"))
+        clock.setRealTime(value);
+    else if (ok && (kind == "step"))
+        clock.setFixedStep(std::chrono::duration_cast<Duration>(seconds));
+    else
+        throw std::invalid_argument("AnimationClock: malformed clock \"" + spec + "\"");
+    return clock;
+}
+
+void AnimationClock::setRealTime(double scale)
+{
+    // Rebase, so the time continues from where it is at the new rate.
+
+    _baseTime = _time;
+    _baseWallTime = Clock::now();
+    _realTime = true;
+    _scale = scale;
+}
+
+void AnimationClock::setFixedStep(Duration step)
+{
+    _realTime = false;
+    _step = step;
+}
+
+bool AnimationClock::realTime() const
+{
+    return _realTime;
+}
+
+double AnimationClock::scale() const
+{
+    return _scale;
+}
+
+AnimationClock::Duration AnimationClock::step() const
+{
+    return _step;
+}
+
+void AnimationClock::start()
+{
+    if (_running)
+        return;
+    _running = true;
+    _baseTime = _time;
+    _baseWallTime = Clock::now();
+}
+
+void AnimationClock::stop()
+{
+    _running = false;
+}
+
+bool AnimationClock::running() const
+{
+    return _running;
+}
+
+void AnimationClock::setTime(Duration t)
+{
+    _time = t;
+    _baseTime = t;
+    _baseWallTime = Clock::now();
+}
+
+AnimationClock::Duration AnimationClock::tick()
+{
+    if (!_running)
+        return _time;
+
+    if (_realTime)
+    {
+        std::chrono::duration<double> elapsed = Clock::now() - _baseWallTime;
+        _time = _baseTime +
+            std::chrono::duration_cast<Duration>(elapsed * _scale);
+    }
+    else
+    {
+        _time += _step;
+    }
+    return _time;
+}
+
+AnimationClock::Duration AnimationClock::time() const
+{
+    return _time;
+}
@@ -0,0 +1,238 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// FacetiousAnimation.h
+//
+// AnimationClock: The time that drives an animation.  It can follow the
+// wall clock, optionally scaled by a factor to run faster or slower, or it
+// can advance by a fixed step per frame, whatever the wall time, so that
+// offline and benchmark runs render exactly the same frames, as fast as
+// the hardware allows and without sleeping.
+//
+// Animation: A sequence of segments, like those of Aut::Anim, each of
+// which moves a channel from one value to another over a duration, with
+// ease-in-ease-out interpolation.  The sequence repeats.  Unlike
+// Aut::Anim, which reads the wall clock itself, it is evaluated at a time
+// given by the caller, usually from an AnimationClock, so a frame at any
+// time can be reproduced.  Nor does it write through pointers to its
+// targets: it evaluates the channels into an array the caller owns.
+//
+// AnimationState: A snapshot of an animation for one frame, with whether
+// its clock is running, its time and the values of its channels.  The
+// thread that evaluates the animation can publish snapshots to other
+// threads through a TripleBuffer, so none of them blocks the others.
+//
+// Neither depends on anything but the C++ standard library.
+//
+
+#ifndef __FacetiousAnimation__
+#define __FacetiousAnimation__
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <string>
+#include <vector>
+
+class AnimationClock
+{
+public:
+
+    typedef std::chrono::steady_clock Clock;
+    typedef Clock::duration Duration;
+
+    // A stopped clock, at time 0, following the wall clock.
+
+    AnimationClock();
+
+    // A stopped clock, at time 0, from a specification of the form
+    // "scale:FACTOR", following the wall clock with the given scale, or
+    // "step:SECONDS", advancing by a fixed step.  Throws an exception if
+    // the specification is malformed.
+
+    static AnimationClock parse(const std::string& spec);
+
+    // Follow the wall clock, with the animation time advancing "scale"
+    // times as fast as the wall time.
+
+    void                setRealTime(double scale = 1.0);
+
+    // Advance the animation time by "step" at each tick(), whatever wall
+    // time has passed.
+
+    void                setFixedStep(Duration step);
+
+    // Whether the clock follows the wall clock, and its scale or step.
+
+    bool                realTime() const;
+    double              scale() const;
+    Duration            step() const;
+
+    // Start and stop the clock.  While it is stopped, tick() does not
+    // advance the time, and starting it again resumes from where it was.
+
+    void                start();
+    void                stop();
+    bool                running() const;
+
+    // Jump to animation time "t".
+
+    void                setTime(Duration t);
+
+    // Advance the time for a new frame, if the clock is running, and
+    // return it.
+
+    Duration            tick();
+
+    // The time returned by the last tick(), or set by setTime().
+
+    Duration            time() const;
+
+private:
+    bool                _realTime;
+    double              _scale;
+    Duration            _step;
+    bool                _running;
+    Duration            _time;
+
+    // For a running real-time clock, the animation time and wall time at
+    // which it was last started or rescaled.
+
+    Duration            _baseTime;
+    Clock::time_point   _baseWallTime;
+};
+
+template <typename T>
+class Animation
+{
+public:
+
+    typedef AnimationClock::Duration Duration;
+
+    // Move channel "channel" from "from" to "to" over "duration".
+
+    struct Segment
+    {
+        Segment(size_t channel, T from, T to, Duration duration) :
+            channel(channel), from(from), to(to), duration(duration) {}
+        size_t          channel;
+        T               from;
+        T               to;
+        Duration        duration;
+    };
+
+    Animation() : _length(0), _channelCount(0) {}
+
+    void                set(const std::vector<Segment>& segments);
+
+    // The duration of one pass through the segments, and the number of
+    // channels, one more than the highest channel of any segment.
+
+    Duration            length() const;
+    size_t              channelCount() const;
+
+    // Set "values[i]", for each channel i from 0 to channelCount() - 1, to
+    // the channel's value at time "t".  A channel's value comes from the
+    // latest of its segments to have started in the current pass, or if
+    // none has, from the end of its last segment in the previous pass, so
+    // the result depends only on "t".  A channel with no segments keeps
+    // its value.
+
+    void                eval(Duration t, T* values) const;
+
+    // The ease-in-ease-out interpolation weight at "u", from 0 to 1.
+
+    static float        ease(float u);
+
+private:
+    std::vector<Segment> _segments;
+    Duration            _length;
+    size_t              _channelCount;
+};
+
+template <typename T, size_t N>
+struct AnimationState
+{
+    AnimationState() : running(false), time(0) { values.fill(T()); }
+    bool                running;
+    AnimationClock::Duration time;
+    std::array<T, N>    values;
+};
+
+template <typename T>
+void Animation<T>::set(const std::vector<Segment>& segments)
+{
+    _segments = segments;
+    _length = Duration(0);
+    _channelCount = 0;
+    for (const Segment& segment : _segments)
+    {
+        _length += segment.duration;
+        _channelCount = std::max(_channelCount, segment.channel + 1);
+    }
+}
+
+template <typename T>
+typename Animation<T>::Duration Animation<T>::length() const
+{
+    return _length;
+}
+
+template <typename T>
+size_t Animation<T>::channelCount() const
+{
+    return _channelCount;
+}
+
+template <typename T>
+void Animation<T>::eval(Duration t, T* values) const
+{
+    if (_length <= Duration(0))
+        return;
+    t %= _length;
+    if (t < Duration(0))
+        t += _length;
+
+    for (const Segment& segment : _segments)
+        values[segment.channel] = segment.to;
+
+    Duration start(0);
+    for (const Segment& segment : _segments)
+    {
+        if (t < start)
+            break;
+        float u = 1.0f;
+        if (segment.duration > Duration(0))
+            u = std::min(1.0f, float(double((t - start).count()) / segment.duration.count()));
+        values[segment.channel] = segment.from + (segment.to - segment.from) * ease(u);
+        start += segment.duration;
+    }
+}
+
+template <typename T>
+float Animation<T>::ease(float u)
+{
+    return u * u * (3.0f - 2.0f * u);
+}
+
+#endif
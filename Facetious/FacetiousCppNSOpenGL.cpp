@@ -26,13 +26,23 @@
 
 #include "FacetiousCppNSOpenGL.h"
 #include "FacetiousShader.h"
+#include "FacetiousFramePipeline.h"
+#include "FacetiousFrameScheduler.h"
+#include "FacetiousFramebuffer.h"
+#include "FacetiousHeightField.h"
+#include "FacetiousRegionDetector.h"
+#include "FacetiousStaticAnimation.h"
+#include "FacetiousStats.h"
+#include "FacetiousSyntheticSource.h"
+#include "FacetiousTextureStreamer.h"
+#include "FacetiousTrace.h"
+#include "FacetiousTripleBuffer.h"
 
 #include "AocCppAVFoundationCamera.h"
 #include "AocCppCIDetector.h"
 
 #include "AglUtilities.h"
 #include "AglShader.h"
-#include "AglImagePool.h"
 #include "AglTextureUbyte.h"
 #include "AglFlattishRectangularSurface.h"
 #include "AglBasicVertexShader.h"
@@ -40,8 +50,6 @@
 #include "AglSphericalHarmonicsFragmentShader.h"
 
 #include "AutAlert.h"
-#include "AutAnim.h"
-#include "AutRunningAverage.h"
 
 #include <OpenEXR/ImathFrustum.h>
 #include <OpenEXR/ImathMatrix.h>
@@ -50,23 +58,31 @@
 #include <OpenGL/gl3.h>
 #include <ImageIO/CGImageSource.h>
 
+#include <algorithm>
 #include <thread>
 #include <chrono>
 #include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
 #include <assert.h>
+#include <stdlib.h>
 
 class FacetiousCppNSOpenGL::Imp
 {
 public:
     
     Imp(Aoc::CppNSOpenGLRequester* r) :
-        camera(0), cameraImage(0), detectorThread(0), detector(0),
-        runDetectorThread(true), detectorImage(0), detectorImageWidthMax(64),
-        detectorImageWidth(0), detectorImageHeight(0), stabilize(true),
-        animTimerThread(0), requester(r), runAnimTimerThread(true),
-        iCurrentShaderProgram(0), frontSurface(0), backSurface(0),
-        frontTexture(0), backTexture(0), viewWidth(0), viewHeight(0),
-        rotAngleX(0.0f), rotAngleY(0.0f) {}
+        source(0), sink(this), pipeline(0), scheduler(0), requester(r),
+        iCurrentShaderProgram(0), frontSurface(0), verticesPerTexel(2.0f),
+        backSurface(0), batchDraw(true), frontTexture(0), backTexture(0),
+        frontTextureStreamer(0), streamFrontTexture(true),
+        frontTextureTopRowFirst(false), heightMap(0),
+        viewWidth(0), viewHeight(0), rotAngleX(0.0f), rotAngleY(0.0f),
+        faceImageVersion(0), faceSequence(0), faceDisplayPending(false),
+        framebuffer(0), renderOnDemand(true),
+        renderedStateValid(false), statsInterval(0), trace(0) {}
     
     // The caller allocates and owns "data".
     
@@ -78,95 +94,209 @@ public:
     static void         getDefaultImage(GLubyte*& data, GLsizei& width,
                                         GLsizei& height);
     
-    void                detectorThreadFunc();
-    void                animTimerThreadFunc();
+    // The front surface's grid and the shader programs that draw it.
     
-    // A derived camera class that handles captured images by making them
-    // available to the face detector.
+    struct FrontSurface
+    {
+        Agl::FlattishRectangularSurface* surface;
+        std::vector<Agl::ShaderProgram*> shaderPrograms;
+    };
+    
+    // The resolution of the front surface's grid for the current maximum
+    // width of the face image, and the front surface with a given
+    // resolution, built on first use.
+    
+    GLsizei             frontResolution() const;
+    FrontSurface*       frontSurfaceFor(GLsizei resolution);
+    
+    void                initPhongFragmentShader(Agl::PhongOneDirectionalFragmentShader* fs);
+    
+    // Everything that affects the rendered frame.  If none of it has
+    // changed since the last frame, the frame need not be rendered again.
+    
+    struct RenderState
+    {
+        bool            operator==(const RenderState& other) const;
+        
+        FrontSurface*   frontSurface;
+        size_t          iShaderProgram;
+        float           rotAngleX;
+        float           rotAngleY;
+        Imath::V3f      ambientColor;
+        Imath::V3f      lightColor;
+        int             viewWidth;
+        int             viewHeight;
+        uint64_t        faceImageVersion;
+    };
     
-    class Camera : public Aoc::CppAVFoundationCamera
+    RenderState         renderState() const;
+    
+    // Record the time from the capture of the current face image to its
+    // first display, if it has not been displayed yet.
+    
+    void                recordFaceDisplayed();
+    
+    // A frame for the FramePipeline, holding an image from the camera.
+    
+    class CGImageFrame : public FramePipeline::Frame
     {
     public:
-        Camera(FacetiousCppNSOpenGL::Imp* imp);
-        virtual void    handleCapturedImage(CGImageRef image);
+        CGImageFrame(CGImageRef image);
+        virtual ~CGImageFrame();
+        virtual int     width() const;
+        virtual int     height() const;
+        virtual void    getTextureData(uint8_t* data) const;
+        virtual void    getTextureData(const FramePipeline::Rect& region,
+                                       uint8_t* data) const;
+        virtual bool    getPixels(FramePipeline::Pixels& pixels) const;
+        CGImageRef      image() const;
         
     private:
-        FacetiousCppNSOpenGL::Imp*     _appImp;
+        CGImageRef      _image;
     };
     
-    Camera*                            camera;
+    // The FramePipeline's detector, a wrapper for Aoc::CppCIDetector.
     
-    // Camera::handleCapturedImage() runs in a system thread, and a
-    // condition variable tells the application when an image is ready.
+    class FaceDetector : public FramePipeline::Detector
+    {
+    public:
+        FaceDetector();
+        virtual void    detect(const FramePipeline::Frame& frame,
+                               std::vector<FramePipeline::Rect>& faces);
+        
+    private:
+        std::unique_ptr<Aoc::CppCIDetector> _detector;
+    };
     
-    std::mutex                         cameraImageMutex;
-    std::condition_variable            cameraImageCond;
-    CGImageRef                         cameraImage;
+    // The FramePipeline's sink, which requests rendering when a face image
+    // is ready and uploads it to the front surface's texture.
     
-    // The face detector is the slowest component of the system, so it runs in
-    // its own thread, allowing rendering to proceed asynchronously with the
-    // latest detected face.
+    class TextureSink : public FramePipeline::Sink
+    {
+    public:
+        TextureSink(FacetiousCppNSOpenGL::Imp* imp);
+        virtual void    faceImageReady();
+        virtual void    receiveFaceImage(const FramePipeline::FaceImage& image);
+        
+    private:
+        FacetiousCppNSOpenGL::Imp*     _appImp;
+    };
     
-    std::thread*                       detectorThread;
-    Aoc::CppCIDetector*                detector;
+    // A derived camera class that handles captured images by making them
+    // available to the face detector.
     
-    // For stopping the face detector thread.
+    class Camera : public Aoc::CppAVFoundationCamera,
+                   public FramePipeline::Source
+    {
+    public:
+        Camera();
+        virtual void    start(FramePipeline* pipeline);
+        virtual void    stop();
+        virtual void    handleCapturedImage(CGImageRef image);
+        
+    private:
+        FramePipeline*                 _pipeline;
+    };
     
-    std::mutex                         runDetectorThreadMutex;
-    bool                               runDetectorThread;
+    // The source of frames is normally the camera.  But setting the
+    // environment variable FACETIOUS_SOURCE to a SyntheticSource
+    // specification (e.g., "file:/tmp/frames.rgba:1280x720@0") replaces it,
+    // for reproducible performance measurements, and setting it to "none"
+    // leaves the default face image in place.
     
-    // A mutex protects data shared by the face detector thread and the
-    // rendering code in the main thread.
-    // The image pool simplifies management of the source and destination
-    // images when reducing the image resolution.
+    FramePipeline::Source*             source;
     
-    std::mutex                         detectorMutex;
-    Agl::ImagePool                     detectorImagePool;
-    GLubyte*                           detectorImage;
-    GLsizei                            detectorImageWidthMax;
-    GLsizei                            detectorImageWidth;
-    GLsizei                            detectorImageHeight;
-    Aoc::CppCIDetector::Face           detectedFace;
+    // The face detector is the slowest component of the system, so the
+    // FramePipeline runs it in its own thread, allowing rendering to proceed
+    // asynchronously with the latest detected face.
     
-    bool                               stabilize;
+    TextureSink                        sink;
+    FramePipeline*                     pipeline;
     
-    // Another thread handles the timing of the animation by generating regular
-    // redraw requests via the requester.
+    // Another thread paces the rendering, issuing redraw requests via the
+    // requester at most once per frame: when the detector has a new face,
+    // when a key has been pressed, or when the animation is running.  The
+    // rate is 30 frames per second, unless FACETIOUS_FRAME_RATE overrides
+    // it.
     
-    std::thread*                       animTimerThread;
+    FrameScheduler*                    scheduler;
     
     Aoc::CppNSOpenGLRequester*         requester;
     
-    // For stopping the animation timer thread.
+    // The animation, a TurnAndNodAnimation resolved at compile time, and
+    // the clock that drives it.  The clock normally follows the wall clock,
+    // but FACETIOUS_ANIMATION_CLOCK can make it run faster or slower
+    // ("scale:FACTOR") or advance by a fixed step of seconds per frame
+    // ("step:SECONDS"), for reproducible frames.  The animation and its
+    // clock are used only by the main thread, which publishes a snapshot
+    // of the animation's state to the scheduler's thread whenever it
+    // changes, so neither thread blocks the other.
     
-    std::mutex                         runAnimTimerThreadMutex;
-    bool                               runAnimTimerThread;
+    typedef TurnAndNodAnimation::Type  Anim;
+    typedef AnimationState<float, TurnAndNodAnimation::ChannelCount> AnimState;
     
-    // The Aut::Anim instance that does the animation is shared between
-    // the animation timer thread and the main thread so it is protected
-    // with a mutex.
+    AnimationClock                     animClock;
+    TripleBuffer<AnimState>            animState;
     
-    std::mutex                         animMutex;
-    Aut::Anim<float>                   anim;
+    void                               animate();
+    void                               publishAnimation();
     
     // Shaders and shader programs.
     
     std::vector<Agl::VertexShaderPNT*> vertexShaders;
+    std::vector<HeightMapVertexShader*> frontVertexShaders;
     std::vector<Agl::Shader*>          fragmentShaders;
     std::vector<Agl::PhongOneDirectionalFragmentShader*>
                                        phongFragmentShaders;
-    std::vector<Agl::ShaderProgram*>   frontShaderPrograms;
     std::vector<Agl::ShaderProgram*>   backShaderPrograms;
     size_t                             iCurrentShaderProgram;
     
     // Surfaces and textures.
     
-    Agl::FlattishRectangularSurface*   frontSurface;
+    // The face image is usually small (64 x 64 by default), so a front
+    // grid much finer than the image only interpolates between the same
+    // texels.  The grid's resolution follows the image's maximum width,
+    // which the user can change, at a ratio of vertices per texel that
+    // FACETIOUS_VERTICES_PER_TEXEL can override.  A front surface is kept
+    // for each resolution used so far, with its own element buffer and
+    // shader programs, so switching back to a resolution costs nothing.
+    
+    std::map<GLsizei, FrontSurface>    frontSurfaces;
+    FrontSurface*                      frontSurface;
+    float                              verticesPerTexel;
+    
     Agl::FlattishRectangularSurface*   backSurface;
     
+    // Whether each front surface's shader programs also draw the back
+    // surface, so each frame binds one program, sets up its shaders once
+    // and issues one draw(), instead of a second program drawing the back
+    // surface.  FACETIOUS_BATCH_DRAW=0 restores the separate programs.
+    
+    bool                               batchDraw;
+    
     Agl::TextureUbyte*                 frontTexture;
     Agl::TextureUbyte*                 backTexture;
     
+    // Face images are uploaded to the front texture through a ring of pixel
+    // buffer objects, so the main thread does not wait for the transfer.
+    // Setting FACETIOUS_TEXTURE_UPLOAD to "sync" uploads them directly
+    // instead, for comparison.
+    
+    TextureStreamer*                   frontTextureStreamer;
+    bool                               streamFrontTexture;
+    
+    // Whether the front texture has its top row first, as it does when it
+    // comes directly from the camera's buffer.
+    
+    bool                               frontTextureTopRowFirst;
+    
+    // The heights for the front surface, computed from the face texture
+    // whenever it changes, rather than by the vertex shader at every
+    // vertex in every frame.
+    
+    HeightMapTexture*                  heightMap;
+    std::vector<GLfloat>               heightMapData;
+    
     // Other rendering-related data.
     
     int                                viewWidth;
@@ -177,35 +307,238 @@ public:
     
     Imath::V3f                         ambientColor;
     Imath::V3f                         lightColor;
+    
+    // Incremented whenever a new face image replaces the front texture.
+    
+    uint64_t                           faceImageVersion;
+    
+    // The frame that the current face image came from.
+    
+    uint64_t                           faceSequence;
+    FramePipeline::Clock::time_point   faceCaptureTime;
+    bool                               faceDisplayPending;
+    
+    // Redraws are requested whenever the face or the animation might have
+    // changed, and also by the window system, so many find nothing new to
+    // render.  The frame is rendered into an offscreen framebuffer, and a
+    // redraw that finds the RenderState unchanged only copies that frame to
+    // the window again.  Setting FACETIOUS_RENDER_ON_DEMAND to 0 renders
+    // every frame directly to the window instead.
+    
+    Framebuffer*                       framebuffer;
+    bool                               renderOnDemand;
+    RenderState                        renderedState;
+    bool                               renderedStateValid;
+    
+    // The rendering stages are recorded in the pipeline's Stats.  If
+    // FACETIOUS_STATS_INTERVAL is set to a number of seconds, draw() dumps
+    // the stats to the standard error that often.
+    
+    std::chrono::steady_clock::duration statsInterval;
+    std::chrono::steady_clock::time_point nextStatsDump;
+    
+    // If FACETIOUS_TRACE is set to a file path, each frame is traced from
+    // capture to display, and the trace is written to that file in
+    // Chrome's trace event format when the application exits.
+    
+    FrameTrace*                        trace;
+    std::string                        tracePath;
 };
 
 //
 
-FacetiousCppNSOpenGL::Imp::Camera::Camera(FacetiousCppNSOpenGL::Imp* imp) :
-    _appImp(imp)
+FacetiousCppNSOpenGL::Imp::CGImageFrame::CGImageFrame(CGImageRef image) :
+    _image(image)
 {
 }
 
-void FacetiousCppNSOpenGL::Imp::Camera::handleCapturedImage(CGImageRef image)
+FacetiousCppNSOpenGL::Imp::CGImageFrame::~CGImageFrame()
+{
+    CGImageRelease(_image);
+}
+
+int FacetiousCppNSOpenGL::Imp::CGImageFrame::width() const
+{
+    return int(CGImageGetWidth(_image));
+}
+
+int FacetiousCppNSOpenGL::Imp::CGImageFrame::height() const
+{
+    return int(CGImageGetHeight(_image));
+}
+
+void FacetiousCppNSOpenGL::Imp::CGImageFrame::getTextureData(uint8_t* data) const
+{
+    getTextureDataFromImage(_image, data);
+}
+
+void FacetiousCppNSOpenGL::Imp::CGImageFrame::getTextureData(const FramePipeline::Rect& region,
+                                                            uint8_t* data) const
 {
+    // The sub-image refers to the original image's data, so only the region
+    // is decoded and drawn.  Core Graphics puts the origin at the top left.
+    
+    CGRect rect = CGRectMake(region.x, height() - (region.y + region.height),
+                             region.width, region.height);
+    CGImageRef subImage = CGImageCreateWithImageInRect(_image, rect);
+    getTextureDataFromImage(subImage, data);
+    CGImageRelease(subImage);
+}
+
+bool FacetiousCppNSOpenGL::Imp::CGImageFrame::getPixels(FramePipeline::Pixels&) const
+{
+    // Core Graphics has no public way to read an image's bytes in place,
+    // and CGDataProviderCopyData() would copy the whole frame, which costs
+    // more than converting only the face region.  So report no pixels, and
+    // let the pipeline convert the region.  The camera's CVPixelBufferRef,
+    // read with CVPixelBufferLockBaseAddress(), would avoid the conversion,
+    // once Aoc::CppAVFoundationCamera exposes it.
+    
+    return false;
+}
+
+CGImageRef FacetiousCppNSOpenGL::Imp::CGImageFrame::image() const
+{
+    return _image;
+}
+
+//
+
+FacetiousCppNSOpenGL::Imp::FaceDetector::FaceDetector() :
+    // The detector is created in one of the pipeline's worker threads, so
+    // it needs its own Objective-C autorelease pool.
+
+    _detector(new Aoc::CppCIDetector(Aoc::CppCIDetector::WorkerThread))
+{
+}
+
+void FacetiousCppNSOpenGL::Imp::FaceDetector::detect(const FramePipeline::Frame& frame,
+                                                     std::vector<FramePipeline::Rect>& faces)
+{
+    std::vector<Aoc::CppCIDetector::Face> detectedFaces;
+    
+    if (const CGImageFrame* imageFrame = dynamic_cast<const CGImageFrame*>(&frame))
     {
-        std::lock_guard<std::mutex> lock(_appImp->cameraImageMutex);
-        if (_appImp->cameraImage)
-            CGImageRelease(_appImp->cameraImage);
-        _appImp->cameraImage = image;
+        _detector->detect(imageFrame->image(), detectedFaces);
     }
-    
-    if (_appImp->detectorImagePool.imageWidth() == 0)
+    else if (const FramePipeline::RawFrame* rawFrame =
+             dynamic_cast<const FramePipeline::RawFrame*>(&frame))
     {
-        // Initialize the image pool.
+        // Wrap the frame's pixels in a CGImage without copying them.
+        
+        size_t width = rawFrame->width();
+        size_t height = rawFrame->height();
+        const size_t bitsPerComp = 8;
+        const size_t bitsPerPixel = 32;
+        CGDataProviderRef provider =
+            CGDataProviderCreateWithData(NULL, rawFrame->pixels(),
+                                         width * height * 4, NULL);
+        CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+        CGBitmapInfo info = (rawFrame->format() == FramePipeline::BGRA) ?
+            (kCGImageAlphaPremultipliedFirst | kCGBitmapByteOrder32Little) :
+            CGBitmapInfo(kCGImageAlphaPremultipliedLast);
+        CGImageRef image = CGImageCreate(width, height, bitsPerComp,
+                                         bitsPerPixel, width * 4, colorSpace,
+                                         info, provider, NULL, false,
+                                         kCGRenderingIntentDefault);
+        CGColorSpaceRelease(colorSpace);
+        CGDataProviderRelease(provider);
         
-        const GLsizei bytesPerPixel = 4;
-        _appImp->detectorImagePool.setImageSize(GLsizei(CGImageGetWidth(image)),
-                                                GLsizei(CGImageGetHeight(image)),
-                                                bytesPerPixel);
+        _detector->detect(image, detectedFaces);
+        CGImageRelease(image);
     }
     
-    _appImp->cameraImageCond.notify_one();
+    for (const Aoc::CppCIDetector::Face& face : detectedFaces)
+        faces.push_back(FramePipeline::Rect(face.x(), face.y(),
+                                            face.width(), face.height()));
+}
+
+//
+
+FacetiousCppNSOpenGL::Imp::TextureSink::TextureSink(FacetiousCppNSOpenGL::Imp* imp) :
+    _appImp(imp)
+{
+}
+
+void FacetiousCppNSOpenGL::Imp::TextureSink::faceImageReady()
+{
+    // Request the rendering, at the next frame.
+    
+    _appImp->scheduler->requestFrame();
+}
+
+void FacetiousCppNSOpenGL::Imp::TextureSink::receiveFaceImage(const FramePipeline::FaceImage& image)
+{
+    // Use the new image from the detector thread to replace the front
+    // surface's texture.
+    
+    // Textures do not need to have power-of-two dimensions with modern
+    // hardware: http://www.opengl.org/wiki/NPOT_Texture
+    
+    // The image may come straight from the camera's buffer, in its native
+    // BGRA layout with the top row first.  Rather than flip it in memory,
+    // the front surface's shaders flip its t texture coordinate.
+    
+    const bool bgra = (image.format == FramePipeline::BGRA);
+    const uint8_t* start = image.data +
+        (image.skipRows * image.rowLength + image.skipPixels) * 4;
+    
+    if (_appImp->streamFrontTexture)
+    {
+        _appImp->frontTextureStreamer->upload(_appImp->frontTexture, start,
+                                              image.width, image.height,
+                                              image.rowLength, !bgra);
+    }
+    else
+    {
+        _appImp->frontTexture->setData(image.data, image.width, image.height,
+                                       GL_RGBA, bgra ? GL_BGRA : GL_RGBA,
+                                       image.rowLength, image.skipPixels,
+                                       image.skipRows);
+    }
+    
+    _appImp->frontTextureTopRowFirst = image.topRowFirst;
+    for (HeightMapVertexShader* vs : _appImp->frontVertexShaders)
+        vs->setFlipTextureT(image.topRowFirst);
+    
+    // Update the heights to match.  The height map always has the bottom
+    // row first.
+    
+    HeightField::makeHeightMap(start, image.width, image.height,
+                               image.rowLength, _appImp->heightMapData,
+                               bgra, image.topRowFirst);
+    _appImp->heightMap->setData(&_appImp->heightMapData[0], image.width,
+                                image.height);
+    
+    ++_appImp->faceImageVersion;
+    _appImp->faceSequence = image.sequence;
+    _appImp->faceCaptureTime = image.captureTime;
+    _appImp->faceDisplayPending = true;
+}
+
+//
+
+FacetiousCppNSOpenGL::Imp::Camera::Camera() :
+    _pipeline(0)
+{
+}
+
+void FacetiousCppNSOpenGL::Imp::Camera::start(FramePipeline* pipeline)
+{
+    _pipeline = pipeline;
+    Aoc::CppAVFoundationCamera::start();
+}
+
+void FacetiousCppNSOpenGL::Imp::Camera::stop()
+{
+    Aoc::CppAVFoundationCamera::stop();
+}
+
+void FacetiousCppNSOpenGL::Imp::Camera::handleCapturedImage(CGImageRef image)
+{
+    // The pipeline takes ownership of the frame, which releases the image.
+    
+    _pipeline->submit(new CGImageFrame(image));
 }
 
 //
@@ -261,185 +594,165 @@ void FacetiousCppNSOpenGL::Imp::getDefaultImage(GLubyte*& data, GLsizei& width,
     getTextureDataFromImage(image, data);
 }
 
-void FacetiousCppNSOpenGL::Imp::detectorThreadFunc()
+bool FacetiousCppNSOpenGL::Imp::RenderState::operator==(const RenderState& other) const
 {
-    // Create the face detector, telling it that it is in its own thread
-    // so it needs its own Objective-C autorelease pool.
+    return (frontSurface == other.frontSurface) &&
+        (iShaderProgram == other.iShaderProgram) &&
+        (rotAngleX == other.rotAngleX) && (rotAngleY == other.rotAngleY) &&
+        (ambientColor == other.ambientColor) &&
+        (lightColor == other.lightColor) && (viewWidth == other.viewWidth) &&
+        (viewHeight == other.viewHeight) &&
+        (faceImageVersion == other.faceImageVersion);
+}
+
+FacetiousCppNSOpenGL::Imp::RenderState FacetiousCppNSOpenGL::Imp::renderState() const
+{
+    RenderState state;
+    state.frontSurface = frontSurface;
+    state.iShaderProgram = iCurrentShaderProgram;
+    state.rotAngleX = rotAngleX;
+    state.rotAngleY = rotAngleY;
+    state.ambientColor = ambientColor;
+    state.lightColor = lightColor;
+    state.viewWidth = viewWidth;
+    state.viewHeight = viewHeight;
+    state.faceImageVersion = faceImageVersion;
+    return state;
+}
+
+void FacetiousCppNSOpenGL::Imp::recordFaceDisplayed()
+{
+    if (!faceDisplayPending)
+        return;
+    faceDisplayPending = false;
+    
+    FramePipeline::Clock::time_point now = FramePipeline::Clock::now();
+    pipeline->stats().histogram(Stats::CaptureToDisplay).record(now - faceCaptureTime);
+    if (trace)
+        trace->span(Stats::name(Stats::CaptureToDisplay), faceSequence,
+                    faceCaptureTime, now);
+}
+
+void FacetiousCppNSOpenGL::Imp::animate()
+{
+    // The animation sets both angles from the clock's time alone.  The
+    // angles keep the values it leaves, so after it stops the arrow keys
+    // change them from there.
+
+    if (animClock.running())
+    {
+        float values[TurnAndNodAnimation::ChannelCount];
+        Anim::eval(animClock.tick(), values);
+        rotAngleX = values[TurnAndNodAnimation::RotAngleX];
+        rotAngleY = values[TurnAndNodAnimation::RotAngleY];
+    }
+    publishAnimation();
+}
+
+void FacetiousCppNSOpenGL::Imp::publishAnimation()
+{
+    AnimState& state = animState.back();
+    state.running = animClock.running();
+    state.time = animClock.time();
+    state.values[TurnAndNodAnimation::RotAngleX] = rotAngleX;
+    state.values[TurnAndNodAnimation::RotAngleY] = rotAngleY;
+    animState.publish();
+}
+
+GLsizei FacetiousCppNSOpenGL::Imp::frontResolution() const
+{
+    const GLsizei resolutionMin = 32;
+    const GLsizei resolutionMax = 512;
+    GLsizei resolution =
+        GLsizei(pipeline->detectorImageWidthMax() * verticesPerTexel);
+    return std::max(resolutionMin, std::min(resolution, resolutionMax));
+}
+
+FacetiousCppNSOpenGL::Imp::FrontSurface*
+FacetiousCppNSOpenGL::Imp::frontSurfaceFor(GLsizei resolution)
+{
+    auto it = frontSurfaces.find(resolution);
+    if (it != frontSurfaces.end())
+        return &it->second;
+    
+    FrontSurface& front = frontSurfaces[resolution];
+    front.surface = new Agl::FlattishRectangularSurface(resolution, resolution);
+    front.surface->setTexture(frontTexture);
     
-    detector = new Aoc::CppCIDetector(Aoc::CppCIDetector::WorkerThread);
+    // There are two programs for each surface, for the two different
+    // fragments shaders implementing two different lighting models.
     
-    // Running averages for stabilizing the detected face.
+    HeightMapVertexShader* vs0 = new HeightMapVertexShader();
+    vs0->setHeightMap(heightMap);
+    vs0->setFlipTextureT(frontTextureTopRowFirst);
+    vertexShaders.push_back(vs0);
+    frontVertexShaders.push_back(vs0);
     
-    Aut::RunningAverage<GLsizei> xAvg;
-    Aut::RunningAverage<GLsizei> yAvg;
-    Aut::RunningAverage<GLsizei> widthAvg;
-    Aut::RunningAverage<GLsizei> heightAvg;
+    Agl::PhongOneDirectionalFragmentShader* fs0 = new Agl::PhongOneDirectionalFragmentShader();
+    fragmentShaders.push_back(fs0);
+    phongFragmentShaders.push_back(fs0);
     
-    bool keepGoing = true;
-    while (keepGoing)
+    HeightMapPhongShaderProgram* p0 = new HeightMapPhongShaderProgram();
+    front.shaderPrograms.push_back(p0);
+    
+    p0->setVertexShader(vs0);
+    p0->setFragmentShader(fs0);
+    p0->addSurface(front.surface);
+    if (batchDraw)
     {
-        CGImageRef image = NULL;
-        
-        {
-            // Wait for an image from the camera.  But stop waiting every
-            // second so the end of the loop can check whether the application
-            // is shutting down and wanting the thread to stop.
-            
-            std::unique_lock<std::mutex> lock (cameraImageMutex);
-            std::chrono::seconds timeout(1);
-            std::cv_status status(std::cv_status::no_timeout);
-            
-            // Set "image" to the latest camera image when it is available.
-            
-            while (!cameraImage && (status == std::cv_status::no_timeout))
-                status = cameraImageCond.wait_for(lock, timeout);
-            if (status == std::cv_status::no_timeout)
-            {
-                image = cameraImage;
-                cameraImage = 0;
-            }
-        }
-        
-        if (image)
-        {
-            // Detect faces in the latest camera image.
-            
-            std::vector<Aoc::CppCIDetector::Face> faces;
-            detector->detect(image, faces);
-            
-            // Choose the face with the maximum dimension.
-            
-            float maxDim = 0;
-            size_t iFaceMaxDim = 0;
-            for (size_t i = 0; i < faces.size(); ++i)
-            {
-                float dim = (faces[i].width() > faces[i].height()) ?
-                    faces[i].width() : faces[i].height();
-                if (dim > maxDim)
-                {
-                    maxDim = dim;
-                    iFaceMaxDim = i;
-                }
-            }
-            
-            if (!faces.empty())
-            {
-                // If a face was found, convert the camera image into
-                // texture data, using the image pool to avoid repeated
-                // reallocations.
-                
-                GLsizei imageWidth = GLsizei(CGImageGetWidth(image));
-                GLsizei imageHeight = GLsizei(CGImageGetHeight(image));
-                GLubyte* newDetectorImage0 = detectorImagePool.alloc();
-                getTextureDataFromImage(image, newDetectorImage0);
-
-                detectedFace = faces[iFaceMaxDim];
-                xAvg.add(detectedFace.x());
-                yAvg.add(detectedFace.y());
-                widthAvg.add(detectedFace.width());
-                heightAvg.add(detectedFace.height());
-                
-                // Apply stabilization to the detected face region if
-                // requested.
-                
-                GLsizei x = stabilize ? xAvg() : detectedFace.x();
-                GLsizei y = stabilize ? yAvg() : detectedFace.y();
-                GLsizei width = stabilize ? widthAvg() : detectedFace.width();
-                GLsizei height = stabilize ? heightAvg() : detectedFace.height();
-
-                // Reduce the image to below the maximum requested width.
-                // This width is user settable, but in general, the results of
-                // LuminanceHeightFieldVertexShader look best when the image
-                // relatively low resolution, like 64 x 64.
-
-                while (width > detectorImageWidthMax)
-                {
-                    // Repeatedly reduce the image by a factor of 2 in each
-                    // dimension.  This simple approach has good enough
-                    // performance in practice.
-                    
-                    width -= width % 2;
-                    GLubyte *newDetectorImage1 = detectorImagePool.alloc();
-                    
-                    const GLsizei bytesPerPixel = 4;
-                    Agl::reduceImageBy2(newDetectorImage1, newDetectorImage0,
-                                        width, height, bytesPerPixel,
-                                        imageWidth, x, y);
-                    
-                    width /= 2;
-                    height /= 2;
-                    imageWidth = width;
-                    imageHeight = height;
-                    x = y = 0;
-                    
-                    detectorImagePool.free(newDetectorImage0);
-                    newDetectorImage0 = newDetectorImage1;
-                }
-                
-                // Make the detected face available to the main thread for
-                // rendering.
-                
-                {
-                    std::lock_guard<std::mutex> lock( detectorMutex);
-                    
-                    delete detectorImage;
-                    detectorImage = newDetectorImage0;
-                    detectorImageWidth = imageWidth;
-                    detectorImageHeight = imageHeight;
-                    detectedFace = Aoc::CppCIDetector::Face(x, y, width, height);
-                }
-                
-                // Request the rendering.
-                
-                requester->redraw();
-            }
-            
-            CGImageRelease(image);
-        }
-        
-        // End this routine if the application is shutting down and needs
-        // the thread to stop.
-        
-        {
-            std::lock_guard<std::mutex> lock(runDetectorThreadMutex);
-            if (!runDetectorThread)
-                keepGoing = false;
-        }
+        vs0->addFlatSurface(backSurface);
+        p0->addSurface(backSurface);
     }
     
-    delete detector;
-}
-
-void FacetiousCppNSOpenGL::Imp::animTimerThreadFunc()
-{
-    // This thread simply generates regular requests to rerender with the
-    // latest animation settings.  (The main thread calls Aut::Anim to
-    // get the latest animation.)
+    HeightMapVertexShader* vs1 = new HeightMapVertexShader();
+    vs1->setHeightMap(heightMap);
+    vs1->setFlipTextureT(frontTextureTopRowFirst);
+    vertexShaders.push_back(vs1);
+    frontVertexShaders.push_back(vs1);
     
-    const int fps = 30;
-    const int sleepMs = 1.0f / fps * 1000;
-    std::chrono::milliseconds sleepDuration(sleepMs);
+    Agl::SphericalHarmonicsFragmentShader* fs1 = new Agl::SphericalHarmonicsFragmentShader();
+    fragmentShaders.push_back(fs1);
+    
+    HeightMapHarmonicsShaderProgram* p1 = new HeightMapHarmonicsShaderProgram();
+    front.shaderPrograms.push_back(p1);
     
-    bool keepGoing = true;
-    while (keepGoing)
+    p1->setVertexShader(vs1);
+    p1->setFragmentShader(fs1);
+    p1->addSurface(front.surface);
+    if (batchDraw)
     {
-        std::this_thread::sleep_for(sleepDuration);
-        
-        {
-            std::lock_guard<std::mutex> lock(animMutex);
-            if (anim.running())
-                requester->redraw();
-        }
-        
-        // End this routine if the application is shutting down and needs
-        // the thread to stop.
-        
-        {
-            std::lock_guard<std::mutex> lock(runAnimTimerThreadMutex);
-            if (!runAnimTimerThread)
-                keepGoing = false;
-        }
+        vs1->addFlatSurface(backSurface);
+        p1->addSurface(backSurface);
+    }
+    
+    try
+    {
+        for (Agl::ShaderProgram* p : front.shaderPrograms)
+            p->build();
+    }
+    catch (const std::exception& exc)
+    {
+        Aut::fatalError(exc.what());
     }
+    
+    front.surface->buildElementArrayBufferObject();
+    
+    initPhongFragmentShader(fs0);
+    
+    return &front;
+}
+
+void FacetiousCppNSOpenGL::Imp::initPhongFragmentShader(Agl::PhongOneDirectionalFragmentShader* fs)
+{
+    Imath::V3f lightDirection = Imath::V3f(1.0f, 1.0f, 1.0f).normalized();
+    float shininess (20.0f);
+    float strength (1.0f);
+    
+    fs->setAmbientColor(ambientColor);
+    fs->setLightColor(lightColor);
+    fs->setLightDirection(lightDirection);
+    fs->setShininess(shininess);
+    fs->setStrength(strength);
 }
 
 //
@@ -447,23 +760,139 @@ void FacetiousCppNSOpenGL::Imp::animTimerThreadFunc()
 FacetiousCppNSOpenGL::FacetiousCppNSOpenGL(Aoc::CppNSOpenGLRequester* r) :
     _m (new Imp(r))
 {
-    _m->camera = new Imp::Camera(_m.get());
+    // Each detector worker processes a different frame, so with several
+    // of them, the face updates more often when detection is slower than
+    // the camera.  The FACETIOUS_DETECTOR_WORKERS environment variable
+    // overrides the default, which leaves half the cores for rendering.
+
+    int workerCount = std::min(4, std::max(1, int(std::thread::hardware_concurrency() / 2)));
+    if (const char* workers = getenv("FACETIOUS_DETECTOR_WORKERS"))
+        workerCount = std::max(1, atoi(workers));
+
+    // The detector sees only a reduced region around the last face, so its
+    // cost depends on the face's size rather than the camera's.
+    // FACETIOUS_DETECTION_WIDTH overrides the width of that region, and 0
+    // hands the detector the full frames.
+
+    int detectionWidthMax = 480;
+    if (const char* width = getenv("FACETIOUS_DETECTION_WIDTH"))
+        detectionWidthMax = std::max(0, atoi(width));
+
+    auto detectorCreator = [=] () -> FramePipeline::Detector* {
+        FramePipeline::Detector* detector = new Imp::FaceDetector;
+        if (detectionWidthMax > 0)
+            detector = new RegionDetector(detector, detectionWidthMax);
+        return detector;
+    };
+
+    _m->pipeline = new FramePipeline(&_m->sink, detectorCreator,
+                                     1920, 1080, workerCount);
+
+    // Between full detections every few frames, the face is tracked, which
+    // costs much less.  FACETIOUS_DETECTION_INTERVAL overrides the number
+    // of frames, and 1 turns tracking off.
+
+    int detectionInterval = 4;
+    if (const char* interval = getenv("FACETIOUS_DETECTION_INTERVAL"))
+        detectionInterval = std::max(1, atoi(interval));
+    _m->pipeline->setDetectionInterval(detectionInterval);
     
-    _m->camera->start();
+    // The detected face is stabilized with a OneEuro filter, unless
+    // FACETIOUS_STABILIZER specifies another, as for Stabilizer::parse()
+    // (e.g., "average:10" for the fixed-window average).
+    
+    if (const char* stabilizer = getenv("FACETIOUS_STABILIZER"))
+    {
+        try
+        {
+            _m->pipeline->setStabilizer(Stabilizer::parse(stabilizer));
+        }
+        catch (const std::exception& exc)
+        {
+            Aut::warning(exc.what());
+        }
+    }
+    
+    if (const char* path = getenv("FACETIOUS_TRACE"))
+    {
+        _m->tracePath = path;
+        _m->trace = new FrameTrace;
+        _m->pipeline->setTrace(_m->trace);
+    }
+    _m->pipeline->start();
+    
+    const char* spec = getenv("FACETIOUS_SOURCE");
+    if (spec && (std::string(spec) == "none"))
+    {
+        _m->source = 0;
+    }
+    else if (spec)
+    {
+        try
+        {
+            _m->source = SyntheticSource::create(spec);
+        }
+        catch (const std::exception& exc)
+        {
+            Aut::fatalError(exc.what());
+        }
+    }
+    else
+    {
+        _m->source = new Imp::Camera;
+    }
+    if (_m->source)
+        _m->source->start(_m->pipeline);
     
-    _m->runDetectorThread = true;
-    _m->detectorThread =
-        new std::thread(std::bind(&Imp::detectorThreadFunc, _m.get()));
+    Imp* imp = _m.get();
+    auto animating = [imp] () -> bool {
+        imp->animState.update();
+        return imp->animState.front().running;
+    };
+    double frameRate = 30.0;
+    if (const char* rate = getenv("FACETIOUS_FRAME_RATE"))
+        frameRate = std::max(1.0, atof(rate));
+    _m->scheduler = new FrameScheduler([imp] () {
+                                           if (imp->requester)
+                                               imp->requester->redraw(); },
+                                       animating, frameRate);
+    _m->scheduler->start();
+    
+    if (const char* clock = getenv("FACETIOUS_ANIMATION_CLOCK"))
+    {
+        try
+        {
+            _m->animClock = AnimationClock::parse(clock);
+        }
+        catch (const std::exception& exc)
+        {
+            Aut::warning(exc.what());
+        }
+    }
     
-    _m->runAnimTimerThread = true;
-    _m->animTimerThread =
-        new std::thread(std::bind(&Imp::animTimerThreadFunc, _m.get()));
+    if (const char* interval = getenv("FACETIOUS_STATS_INTERVAL"))
+    {
+        std::chrono::duration<double> seconds(std::max(0.0, atof(interval)));
+        _m->statsInterval =
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(seconds);
+        _m->nextStatsDump = std::chrono::steady_clock::now() + _m->statsInterval;
+    }
 }
 
 FacetiousCppNSOpenGL::~FacetiousCppNSOpenGL()
 {
-    for (Agl::ShaderProgram* p : _m->frontShaderPrograms)
-        delete p;
+    // Stop requesting redraws before anything they would draw is deleted.
+    // The pipeline's workers may still request frames until it stops, so
+    // the scheduler itself is deleted last.
+    
+    _m->scheduler->stop();
+    
+    for (auto& entry : _m->frontSurfaces)
+    {
+        for (Agl::ShaderProgram* p : entry.second.shaderPrograms)
+            delete p;
+        delete entry.second.surface;
+    }
     for (Agl::ShaderProgram* p : _m->backShaderPrograms)
         delete p;
     
@@ -472,30 +901,31 @@ FacetiousCppNSOpenGL::~FacetiousCppNSOpenGL()
     for (Agl::Shader* s : _m->fragmentShaders)
         delete s;
     
-    delete _m->frontSurface;
     delete _m->backSurface;
     
+    delete _m->framebuffer;
+    delete _m->frontTextureStreamer;
     delete _m->frontTexture;
     delete _m->backTexture;
+    delete _m->heightMap;
     
-    _m->camera->stop();
-    delete _m->camera;
-    
-    {
-        std::lock_guard<std::mutex> lock(_m->runDetectorThreadMutex);
-        _m->runDetectorThread = false;
-    }
+    if (_m->source)
+        _m->source->stop();
+    delete _m->source;
     
-    _m->detectorThread->join();
-    delete _m->detectorThread;
+    _m->pipeline->stop();
+    delete _m->pipeline;
     
+    if (_m->trace)
     {
-        std::lock_guard<std::mutex> lock(_m->runAnimTimerThreadMutex);
-        _m->runAnimTimerThread = false;
+        std::ofstream out(_m->tracePath.c_str());
+        _m->trace->writeChromeTrace(out);
+        if (!out)
+            Aut::warning(("Could not write the trace to " + _m->tracePath).c_str());
+        delete _m->trace;
     }
     
-    _m->animTimerThread->join();
-    delete _m->animTimerThread;
+    delete _m->scheduler;
 }
 
 void FacetiousCppNSOpenGL::init()
@@ -508,51 +938,61 @@ void FacetiousCppNSOpenGL::init()
 
     glClearColor(0.4f, 0.4f, 0.5f, 1.0);
 
-    // Initialize the front and back surfaces.  The front surface is flat
-    // at this point, but will be heights computed at each vertex based on
-    // the image of the detected face by LuminanceHeightFieldVertexShader.
-    // The back surface has a bit of a bulge, to make it more interesting.
+    // The initial lighting for the Phong shaders.
     
-    const GLsizei resFront = 512;
-    const GLsizei resBack = 256;
-    const GLfloat bulgeBack = 0.1f;
-    _m->frontSurface = new Agl::FlattishRectangularSurface(resFront, resFront);
-    _m->backSurface = new Agl::FlattishRectangularSurface(resBack, resBack,
-                                                          bulgeBack);
+    _m->ambientColor = Imath::V3f(0.3f, 0.3f, 0.3f);
+    _m->lightColor = Imath::V3f(0.6f, 0.6f, 0.6f);
     
-    // Initialize the shaders and the shader programs.  There are two programs
-    // for each surface, for the two different fragments shaders implementing
-    // two different lighting models.  The front and the back surfaces use
-    // different vertex shaders, because only the front surface should have
-    // heights computed at each vertex by LuminanceHeightFieldVertexShader.
+    // Initialize the front surface's texture with a default face image,
+    // obtained from the bundle's resources, and the height map computed
+    // from it.
+
+    GLubyte* frontTextureColors;
+    GLsizei frontTextureWidth, frontTextureHeight;
+    Imp::getDefaultImage(frontTextureColors, frontTextureWidth, frontTextureHeight);
+
+    _m->frontTexture = new Agl::TextureUbyte(GL_TEXTURE_2D);
+    _m->frontTexture->build();
+    _m->frontTexture->setData(frontTextureColors, frontTextureWidth, frontTextureHeight);
     
-    LuminanceHeightFieldVertexShader* vs0 = new LuminanceHeightFieldVertexShader();
-    _m->vertexShaders.push_back(vs0);
+    if (const char* upload = getenv("FACETIOUS_TEXTURE_UPLOAD"))
+        _m->streamFrontTexture = (std::string(upload) != "sync");
+    _m->frontTextureStreamer = new TextureStreamer;
     
-    Agl::PhongOneDirectionalFragmentShader* fs0 = new Agl::PhongOneDirectionalFragmentShader();
-    _m->fragmentShaders.push_back(fs0);
-    _m->phongFragmentShaders.push_back(fs0);
+    _m->heightMap = new HeightMapTexture;
+    HeightField::makeHeightMap(frontTextureColors, frontTextureWidth,
+                               frontTextureHeight, frontTextureWidth,
+                               _m->heightMapData);
+    _m->heightMap->setData(&_m->heightMapData[0], frontTextureWidth,
+                           frontTextureHeight);
     
-    LuminancePhongShaderProgram* p0 = new LuminancePhongShaderProgram();
-    _m->frontShaderPrograms.push_back(p0);
+    delete [] frontTextureColors;
     
-    p0->setVertexShader(vs0);
-    p0->setFragmentShader(fs0);
-    p0->addSurface(_m->frontSurface);
-
-    LuminanceHeightFieldVertexShader* vs1 = new LuminanceHeightFieldVertexShader();
-    _m->vertexShaders.push_back(vs1);
+    // Create the back surface, which the front surface's shader programs
+    // may also draw.  It has a bit of a bulge, to make it more interesting.
     
-    Agl::SphericalHarmonicsFragmentShader* fs1 = new Agl::SphericalHarmonicsFragmentShader();
-    _m->fragmentShaders.push_back(fs1);
+    const GLsizei resBack = 256;
+    const GLfloat bulgeBack = 0.1f;
+    _m->backSurface = new Agl::FlattishRectangularSurface(resBack, resBack,
+                                                          bulgeBack);
+    if (const char* batch = getenv("FACETIOUS_BATCH_DRAW"))
+        _m->batchDraw = (atoi(batch) != 0);
     
-    LuminanceHarmonicsShaderProgram* p1 = new LuminanceHarmonicsShaderProgram();
-    _m->frontShaderPrograms.push_back(p1);
+    // Initialize the front surface, at the resolution for the initial
+    // face image width.  It is flat at this point, but will be heights
+    // computed at each vertex based on the image of the detected face by
+    // HeightMapVertexShader.
+    
+    if (const char* ratio = getenv("FACETIOUS_VERTICES_PER_TEXEL"))
+        _m->verticesPerTexel = std::max(0.25f, float(atof(ratio)));
+    _m->frontSurface = _m->frontSurfaceFor(_m->frontResolution());
+    
+    // Initialize the back surface's shaders and the shader programs.  There
+    // are two programs, for the two different fragments shaders
+    // implementing two different lighting models, as for the front
+    // surface.  The back surface uses a different vertex shader, because
+    // only the front surface should have heights computed at each vertex.
     
-    p1->setVertexShader(vs1);
-    p1->setFragmentShader(fs1);
-    p1->addSurface(_m->frontSurface);
-
     Agl::BasicVertexShader* vs2 = new Agl::BasicVertexShader();
     _m->vertexShaders.push_back(vs2);
     
@@ -584,8 +1024,6 @@ void FacetiousCppNSOpenGL::init()
     
     try
     {
-        for (Agl::ShaderProgram* p : _m->frontShaderPrograms)
-            p->build();
         for (Agl::ShaderProgram* p : _m->backShaderPrograms)
             p->build();
     }
@@ -594,39 +1032,9 @@ void FacetiousCppNSOpenGL::init()
         Aut::fatalError(exc.what());
     }
     
-    _m->frontSurface->buildElementArrayBufferObject();
     _m->backSurface->buildElementArrayBufferObject();
     
-    // Initialize the Phong shaders' light.
-    
-    _m->ambientColor = Imath::V3f(0.3f, 0.3f, 0.3f);
-    _m->lightColor = Imath::V3f(0.6f, 0.6f, 0.6f);
-    Imath::V3f lightDirection = Imath::V3f(1.0f, 1.0f, 1.0f).normalized();
-    float shininess (20.0f);
-    float strength (1.0f);
-    
-    for (Agl::PhongOneDirectionalFragmentShader* fs : _m->phongFragmentShaders)
-    {
-        fs->setAmbientColor(_m->ambientColor);
-        fs->setLightColor(_m->lightColor);
-        fs->setLightDirection(lightDirection);
-        fs->setShininess(shininess);
-        fs->setStrength(strength);
-    }
-    
-    // Initialize the front surface's texture with a default face image, obtained from
-    // the bundle's resources.
-
-    GLubyte* frontTextureColors;
-    GLsizei frontTextureWidth, frontTextureHeight;
-    Imp::getDefaultImage(frontTextureColors, frontTextureWidth, frontTextureHeight);
-
-    _m->frontTexture = new Agl::TextureUbyte(GL_TEXTURE_2D);
-    _m->frontTexture->build();
-    _m->frontTexture->setData(frontTextureColors, frontTextureWidth, frontTextureHeight);
-    _m->frontSurface->setTexture(_m->frontTexture);
-    
-    delete [] frontTextureColors;
+    _m->initPhongFragmentShader(fs2);
     
     // The back surface is meant to be a solid white, so it has a very
     // simple texture.
@@ -639,26 +1047,19 @@ void FacetiousCppNSOpenGL::init()
     _m->backTexture->setData(backTextureColors, backTextureDimension, backTextureDimension);
     _m->backSurface->setTexture(_m->backTexture);
     
-    // Set up the animation.  It involves rotating to the left, to the right,
-    // and back to the center, then rotating down, and up, and back to the
-    // center.  This pattern then repeats.
+    // The offscreen framebuffer for rendering on demand.  It gets its size
+    // in reshape().
     
-    std::vector<Aut::Anim<float>::Segment> animSegments;
-    animSegments.push_back(Aut::Anim<float>::Segment(&_m->rotAngleY, 0, 50,
-                                                     std::chrono::seconds(5)));
-    animSegments.push_back(Aut::Anim<float>::Segment(&_m->rotAngleY, 50, -50,
-                                                     std::chrono::seconds(10)));
-    animSegments.push_back(Aut::Anim<float>::Segment(&_m->rotAngleY, -50, 0,
-                                                     std::chrono::seconds(5)));
-    animSegments.push_back(Aut::Anim<float>::Segment(&_m->rotAngleX, 0, 50,
-                                                     std::chrono::seconds(5)));
-    animSegments.push_back(Aut::Anim<float>::Segment(&_m->rotAngleX, 50, -50,
-                                                     std::chrono::seconds(10)));
-    animSegments.push_back(Aut::Anim<float>::Segment(&_m->rotAngleX, -50, 0,
-                                                     std::chrono::seconds(5)));
-
-    _m->anim.set(animSegments);
-    _m->anim.start();
+    if (const char* onDemand = getenv("FACETIOUS_RENDER_ON_DEMAND"))
+        _m->renderOnDemand = (atoi(onDemand) != 0);
+    if (_m->renderOnDemand)
+        _m->framebuffer = new Framebuffer;
+    
+    // Start the animation, whose segments are fixed at compile time by
+    // TurnAndNodAnimation.
+    
+    _m->animClock.start();
+    _m->publishAnimation();
 }
 
 void FacetiousCppNSOpenGL::reshape(int width, int height)
@@ -666,42 +1067,80 @@ void FacetiousCppNSOpenGL::reshape(int width, int height)
     _m->viewWidth = width;
     _m->viewHeight = height;
     glViewport(0, 0, _m->viewWidth, _m->viewHeight);
+    
+    // A view with no pixels, like a collapsed one, cannot have a complete
+    // framebuffer, so the framebuffer keeps its last size until the view
+    // has pixels again.  What it holds is out of date either way.
+    
+    if (_m->framebuffer)
+    {
+        if ((width > 0) && (height > 0))
+        {
+            try
+            {
+                _m->framebuffer->resize(width, height);
+            }
+            catch (const std::exception& exc)
+            {
+                // Without the offscreen framebuffer, render every frame.
+                
+                Aut::warning(exc.what());
+                delete _m->framebuffer;
+                _m->framebuffer = 0;
+            }
+        }
+        _m->renderedStateValid = false;
+    }
 }
 
 void FacetiousCppNSOpenGL::draw()
 {
+    Stats& stats = _m->pipeline->stats();
+    
+    if (_m->statsInterval.count() > 0)
     {
-        std::unique_lock<std::mutex> lock(_m-> detectorMutex, std::try_to_lock);
-
-        if (lock && _m->detectorImage)
-        {            
-            // If a new image is available from the detector thread, use
-            // it to replace front surface's texture.
-
-            GLsizei width = _m->detectedFace.width();
-            GLint x = _m->detectedFace.x();
-            GLint y = _m->detectedFace.y();
-            
-            GLsizei textureDim = width;
-            GLint rowLength = _m->detectorImageWidth;
-            GLint skipPixels = x;
-            GLint skipRows = y;
-            
-            // Textures do not need to have power-of-two dimensions with modern
-            // hardware: http://www.opengl.org/wiki/NPOT_Texture
-            
-            // TODO: Performance may be better if the code can use format
-            // GL_BGRA and type GL_UNSIGNED_INT_8_8_8_8_REV.
-            
-            _m->frontTexture->setData(_m->detectorImage, textureDim, textureDim,
-                                      GL_RGBA, GL_RGBA,
-                                      rowLength, skipPixels, skipRows);
-            
-            _m->detectorImagePool.free(_m->detectorImage);
-            _m->detectorImage = 0;
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (now >= _m->nextStatsDump)
+        {
+            stats.dump(std::cerr);
+            _m->nextStatsDump = now + _m->statsInterval;
         }
     }
     
+    // If a new image is available from the detector thread, the pipeline
+    // gives it to the sink to replace the front surface's texture.
+    
+    _m->pipeline->deliver();
+    
+    StageTimer timer(stats, Stats::Draw, _m->trace, _m->faceSequence);
+    
+    // Switch to the front surface for the current face image width,
+    // which the user may have changed.
+    
+    _m->frontSurface = _m->frontSurfaceFor(_m->frontResolution());
+    
+    // Get the latest animation for the rotaton angles.
+    
+    _m->animate();
+    
+    // If nothing that affects the frame has changed, show the last frame
+    // again rather than rendering it.  Otherwise render it offscreen.
+    
+    GLint window = 0;
+    Imp::RenderState state = _m->renderState();
+    if (_m->framebuffer)
+    {
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &window);
+        if (_m->renderedStateValid && (state == _m->renderedState))
+        {
+            _m->framebuffer->present(window);
+            stats.add(Stats::FramesReused);
+            _m->recordFaceDisplayed();
+            return;
+        }
+        _m->framebuffer->bind();
+    }
+    
     // Prepare to render the new frame.
     
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -723,21 +1162,14 @@ void FacetiousCppNSOpenGL::draw()
         vs->setProjectionMatrix(project);
     }
     
-    // Get the latest animation for the rotaton angles, and apply it to
-    // the surfaces' model matrices.
-    
-    {
-        std::lock_guard<std::mutex> lock(_m->animMutex);
-        
-        _m->anim.eval();
-    }
+    // Apply the rotation angles to the surfaces' model matrices.
     
     Imath::M44f frontRot, backRot;
     const float toRadians = M_PI / 180.0f;
     frontRot.setEulerAngles(Imath::V3f(_m->rotAngleX * toRadians, _m->rotAngleY * toRadians, 0));
     backRot.setEulerAngles(Imath::V3f(M_PI, 0.0f, 0.0f));
     backRot *= frontRot;
-    _m->frontSurface->setModelMatrix(frontRot);
+    _m->frontSurface->surface->setModelMatrix(frontRot);
     _m->backSurface->setModelMatrix(backRot);
     
     // Update the shaders with parameters the user might have changed.
@@ -749,17 +1181,72 @@ void FacetiousCppNSOpenGL::draw()
     }
     
     // Render the surfaces with the user's current choice for the shader
-    // programs.
+    // programs.  When batched, the front surface's program draws both.
     
     try
     {
-        _m->frontShaderPrograms[_m->iCurrentShaderProgram]->draw();
-        _m->backShaderPrograms[_m->iCurrentShaderProgram]->draw();
+        {
+            LatencyHistogram::Timer timer(stats.histogram(Stats::DrawFront));
+            _m->frontSurface->shaderPrograms[_m->iCurrentShaderProgram]->draw();
+        }
+        if (!_m->batchDraw)
+        {
+            LatencyHistogram::Timer timer(stats.histogram(Stats::DrawBack));
+            _m->backShaderPrograms[_m->iCurrentShaderProgram]->draw();
+        }
     }
     catch (const std::exception& exc)
     {
         Aut::warning(exc.what());
     }
+    stats.add(Stats::FramesRendered);
+    
+    if (_m->framebuffer)
+    {
+        _m->framebuffer->present(window);
+        _m->renderedState = state;
+        _m->renderedStateValid = true;
+    }
+    
+    _m->recordFaceDisplayed();
+}
+
+void FacetiousCppNSOpenGL::setRotation(float angleX, float angleY)
+{
+    _m->animClock.stop();
+    _m->rotAngleX = angleX;
+    _m->rotAngleY = angleY;
+    _m->publishAnimation();
+}
+
+void FacetiousCppNSOpenGL::setAnimationStep(double time, double step)
+{
+    typedef AnimationClock::Duration Duration;
+    
+    _m->animClock.setFixedStep(std::chrono::duration_cast<Duration>(std::chrono::duration<double>(step)));
+    _m->animClock.setTime(std::chrono::duration_cast<Duration>(std::chrono::duration<double>(time)));
+    _m->animClock.start();
+    _m->publishAnimation();
+}
+
+uint64_t FacetiousCppNSOpenGL::faceImagesReceived() const
+{
+    return _m->faceImageVersion;
+}
+
+void FacetiousCppNSOpenGL::freezeFace()
+{
+    if (_m->source)
+    {
+        _m->source->stop();
+        delete _m->source;
+        _m->source = 0;
+    }
+    
+    // With the workers stopped, nothing is published after this delivery.
+    
+    _m->pipeline->stop();
+    _m->pipeline->deliver();
 }
 
 void FacetiousCppNSOpenGL::keyDown(Aoc::CppNSOpenGLBase::KeyEvent keyEvent)
@@ -819,27 +1306,29 @@ void FacetiousCppNSOpenGL::keyDown(Aoc::CppNSOpenGLBase::KeyEvent keyEvent)
         // 'l' for "lighting".
         
         _m->iCurrentShaderProgram =
-            (_m->iCurrentShaderProgram + 1) % _m->frontShaderPrograms.size();
+            (_m->iCurrentShaderProgram + 1) % _m->backShaderPrograms.size();
     }
     else if (keyEvent.character() == 'r')
     {
         // 'r'/'R' for "resolution".
         
-        if (_m->detectorImageWidthMax > 32)
-            _m->detectorImageWidthMax /= 2;
+        int widthMax = _m->pipeline->detectorImageWidthMax();
+        if (widthMax > 32)
+            _m->pipeline->setDetectorImageWidthMax(widthMax / 2);
     }
     else if (keyEvent.character() == 'R')
     {
         // 'r'/'R' for "resolution".
         
-        if (_m->detectorImageWidthMax < 2048)
-            _m->detectorImageWidthMax *= 2;
+        int widthMax = _m->pipeline->detectorImageWidthMax();
+        if (widthMax < 2048)
+            _m->pipeline->setDetectorImageWidthMax(widthMax * 2);
     }
     else if (keyEvent.character() == 's')
     {
         // 's' for "stabilize".
         
-        _m->stabilize = !_m->stabilize;
+        _m->pipeline->setStabilize(!_m->pipeline->stabilize());
     }
     else if (keyEvent.character() == ' ')
     {
@@ -854,19 +1343,23 @@ void FacetiousCppNSOpenGL::keyDown(Aoc::CppNSOpenGLBase::KeyEvent keyEvent)
     // this event-handling routine is run in the main thread that also
     // runs the draw() routine.  So there is no need for a lock to
     // prevent race conditions with the draw() routine for the access
-    // to _m->rotAngleX and the other values set above.
-    // But the _m->anim is accessed by _m->animTimerThread, so a lock
-    // is needed for it.
+    // to _m->rotAngleX and the other values set above, or to the
+    // animation clock.  The scheduler's thread sees only the snapshot of
+    // the animation's state published when it changes.
     
     if (stopAnim || startAnim)
     {
-        std::lock_guard<std::mutex> lock(_m->animMutex);
-        
         if (startAnim)
-            _m->anim.start();
+        {
+            _m->animClock.setTime(AnimationClock::Duration(0));
+            _m->animClock.start();
+        }
         else if (stopAnim)
-            _m->anim.stop();
+        {
+            _m->animClock.stop();
+        }
+        _m->publishAnimation();
     }
     
-    _m->requester->redraw();
+    _m->scheduler->requestFrame();
 }
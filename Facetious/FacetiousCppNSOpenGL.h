@@ -34,6 +34,7 @@
 #define __FacetiousCppNSOpenGL__
 
 #include "AocCppNSOpenGLBase.h"
+#include <stdint.h>
 
 class FacetiousCppNSOpenGL : public Aoc::CppNSOpenGLBase
 {
@@ -62,6 +63,24 @@ public:
     
     virtual void keyDown(Aoc::CppNSOpenGLBase::KeyEvent keyEvent);
     
+    // For rendering reproducible frames, as FacetiousRegression.cpp does:
+    // stop the animation and set the rotation angles, in degrees, and get
+    // the number of face images received from the detector so far.  Must
+    // be called from the thread that calls draw().
+    
+    void setRotation(float angleX, float angleY);
+    uint64_t faceImagesReceived() const;
+    
+    // Run the animation from "time" seconds, advancing it by "step" seconds
+    // at each draw() rather than following the wall clock.
+    
+    void setAnimationStep(double time, double step);
+    
+    // Stop the source of frames and the detection, after showing the face
+    // image last published, so the face stays the same from then on.
+    
+    void freezeFace();
+    
 private:
     
     // Details of the class' data are hidden in the .cpp file.
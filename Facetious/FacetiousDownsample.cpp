@@ -0,0 +1,489 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+//  FacetiousDownsample.cpp
+//
+
+#include "FacetiousDownsample.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    const int bytesPerPixel = 4;
+
+    // The most bytes whose sum fits in 16 bits.
+
+    const int maxSum16 = 257;
+
+    // The most rows added to the sums in registers before they are stored.
+
+    const int rowsPerPass = 4;
+
+    // The column sums and prefix sums hold each pixel's channels in this
+    // order, in which the vectorized paths can interleave the sums of the
+    // even and odd bytes with no extra work, and the averaging can put the
+    // quotients back in order with a single shuffle.  It is its own inverse.
+
+    const int channelOrder[bytesPerPixel] = { 0, 2, 1, 3 };
+
+    // The running sums of alternate pixels, which "prefix" points to below,
+    // start with two pixels of 0, and each following pixel is the previous
+    // but one plus the corresponding pixel of the row's column sums, channel
+    // by channel.  The sum of the pixels before column "c" is then the sum
+    // of prefix pixels "c" and "c" + 1, so the sums of a destination pixel's
+    // block come from four prefix pixels however many columns it covers,
+    // and unlike a running sum of every pixel there is no dependency between
+    // neighbouring lanes to shuffle across.  When every block's sums fit in
+    // 16 bits, the prefix sums may wrap at 16 bits, as their differences
+    // are still exact.
+
+    // Add the "n" bytes of each of "K" rows, starting at "src" and "stride"
+    // bytes apart, to the "n" elements of "sums", or if "first" set "sums"
+    // to them.  The vectorized paths widen the bytes by masking and
+    // shifting, which unlike unpacking does not compete for the shuffle
+    // unit, and so keep the sums of the even and odd bytes apart until
+    // "last", when they interleave them in "channelOrder".  Then, if
+    // "prefix" is not null, the sums go straight into the 16-bit prefix
+    // sums rather than back to "sums".
+
+    template <int K>
+    void addRows(uint16_t* sums, const uint8_t* src, size_t stride, int n,
+                 bool first, bool last, uint16_t* prefix)
+    {
+        int i = 0;
+        if (!last)
+            prefix = 0;
+        if (prefix)
+        {
+            for (int k = 0; k < 2 * bytesPerPixel; ++k)
+                prefix[k] = 0;
+        }
+
+#if defined(__SSE2__)
+
+        __m128i carry = _mm_setzero_si128();
+
+#endif
+
+#if defined(__AVX2__)
+
+        const __m256i wideMask = _mm256_set1_epi16(0xff);
+        for (; i + 32 <= n; i += 32)
+        {
+            __m256i* s = reinterpret_cast<__m256i*>(sums + i);
+            __m256i even = first ? _mm256_setzero_si256() : _mm256_loadu_si256(s);
+            __m256i odd = first ? _mm256_setzero_si256() : _mm256_loadu_si256(s + 1);
+            const uint8_t* p = src + i;
+            for (int r = 0; r < K; ++r, p += stride)
+            {
+                __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+                even = _mm256_add_epi16(even, _mm256_and_si256(b, wideMask));
+                odd = _mm256_add_epi16(odd, _mm256_srli_epi16(b, 8));
+            }
+            if (last)
+            {
+                // Unpacking interleaves within each 128-bit lane, so the
+                // pairs of pixels are taken from the lanes in order.
+
+                __m256i lo = _mm256_unpacklo_epi32(even, odd);
+                __m256i hi = _mm256_unpackhi_epi32(even, odd);
+                if (prefix)
+                {
+                    __m128i* q = reinterpret_cast<__m128i*>(prefix + i + 2 * bytesPerPixel);
+                    carry = _mm_add_epi16(carry, _mm256_castsi256_si128(lo));
+                    _mm_storeu_si128(q, carry);
+                    carry = _mm_add_epi16(carry, _mm256_castsi256_si128(hi));
+                    _mm_storeu_si128(q + 1, carry);
+                    carry = _mm_add_epi16(carry, _mm256_extracti128_si256(lo, 1));
+                    _mm_storeu_si128(q + 2, carry);
+                    carry = _mm_add_epi16(carry, _mm256_extracti128_si256(hi, 1));
+                    _mm_storeu_si128(q + 3, carry);
+                    continue;
+                }
+                even = _mm256_permute2x128_si256(lo, hi, 0x20);
+                odd = _mm256_permute2x128_si256(lo, hi, 0x31);
+            }
+            _mm256_storeu_si256(s, even);
+            _mm256_storeu_si256(s + 1, odd);
+        }
+
+#endif
+
+#if defined(__SSE2__)
+
+        const __m128i mask = _mm_set1_epi16(0xff);
+        for (; i + 16 <= n; i += 16)
+        {
+            __m128i* s = reinterpret_cast<__m128i*>(sums + i);
+            __m128i even = first ? _mm_setzero_si128() : _mm_loadu_si128(s);
+            __m128i odd = first ? _mm_setzero_si128() : _mm_loadu_si128(s + 1);
+            const uint8_t* p = src + i;
+            for (int r = 0; r < K; ++r, p += stride)
+            {
+                __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+                even = _mm_add_epi16(even, _mm_and_si128(b, mask));
+                odd = _mm_add_epi16(odd, _mm_srli_epi16(b, 8));
+            }
+            if (last)
+            {
+                __m128i lo = _mm_unpacklo_epi32(even, odd);
+                __m128i hi = _mm_unpackhi_epi32(even, odd);
+                if (prefix)
+                {
+                    __m128i* q = reinterpret_cast<__m128i*>(prefix + i + 2 * bytesPerPixel);
+                    carry = _mm_add_epi16(carry, lo);
+                    _mm_storeu_si128(q, carry);
+                    carry = _mm_add_epi16(carry, hi);
+                    _mm_storeu_si128(q + 1, carry);
+                    continue;
+                }
+                even = lo;
+                odd = hi;
+            }
+            _mm_storeu_si128(s, even);
+            _mm_storeu_si128(s + 1, odd);
+        }
+
+#endif
+
+        // The rest, a pixel at a time, as the channels move when "last".
+
+        for (; i < n; i += bytesPerPixel)
+        {
+            uint16_t pixel[bytesPerPixel];
+            for (int k = 0; k < bytesPerPixel; ++k)
+            {
+                unsigned sum = first ? 0 : sums[i + k];
+                for (int r = 0; r < K; ++r)
+                    sum += src[r * stride + i + k];
+                pixel[last ? channelOrder[k] : k] = uint16_t(sum);
+            }
+            for (int k = 0; k < bytesPerPixel; ++k)
+            {
+                if (prefix)
+                    prefix[i + 2 * bytesPerPixel + k] = uint16_t(prefix[i + k] + pixel[k]);
+                else
+                    sums[i + k] = pixel[k];
+            }
+        }
+    }
+
+    // Set each of the "n" elements of "sums" to the sum of the corresponding
+    // bytes in the "rows" rows starting at "src", which are "stride" bytes
+    // apart, with the channels in "channelOrder", or if "prefix" is not
+    // null, set it to their 16-bit prefix sums instead.  There must be no more than "maxSum16" rows.  The rows are
+    // read in order, which the hardware prefetches better than reading down
+    // the columns, and added a few at a time, to store the sums less often.
+
+    void sumRows(uint16_t* sums, const uint8_t* src, size_t stride, int rows, int n,
+                 uint16_t* prefix = 0)
+    {
+        assert((rows > 0) && (rows <= maxSum16));
+        for (int r = 0; r < rows; r += rowsPerPass, src += rowsPerPass * stride)
+        {
+            int k = std::min(rowsPerPass, rows - r);
+            bool first = (r == 0);
+            bool last = (r + k == rows);
+            switch (k)
+            {
+            case 1:
+                addRows<1>(sums, src, stride, n, first, last, prefix);
+                break;
+            case 2:
+                addRows<2>(sums, src, stride, n, first, last, prefix);
+                break;
+            case 3:
+                addRows<3>(sums, src, stride, n, first, last, prefix);
+                break;
+            default:
+                addRows<4>(sums, src, stride, n, first, last, prefix);
+                break;
+            }
+        }
+    }
+
+    // Set "prefix" to the 32-bit prefix sums of the "width" pixels in "sums".
+
+    template <typename Sum>
+    void prefixSums(uint32_t* prefix, const Sum* sums, int width)
+    {
+        const int n = width * bytesPerPixel;
+        for (int k = 0; k < 2 * bytesPerPixel; ++k)
+            prefix[k] = 0;
+        for (int k = 0; k < n; ++k)
+            prefix[k + 2 * bytesPerPixel] = prefix[k] + sums[k];
+    }
+
+    // The reciprocal of "count" in 0.32 fixed point, which divides exactly
+    // any rounded total of "count" bytes, or 0 if "count" is 1 or too large
+    // for that, and must be divided by directly.
+
+    uint32_t reciprocal(uint32_t count)
+    {
+        const uint64_t one = uint64_t(1) << 32;
+        uint64_t maxTotal = uint64_t(count) * 255 + count / 2;
+        if ((count < 2) || (maxTotal * count >= one))
+            return 0;
+        return uint32_t(one / count + 1);
+    }
+
+    // Each destination pixel's scale is four copies of the reciprocal of its
+    // block's count of pixels, then four of half the count, for rounding.
+
+    const int scaleSize = 2 * bytesPerPixel;
+
+#if defined(__SSE2__)
+
+    // The sums of the pixels between the columns at two pointers to prefix
+    // sums, widened to 32 bits.
+
+    inline __m128i blockSums(const uint32_t* p0, const uint32_t* p1)
+    {
+        const __m128i* q0 = reinterpret_cast<const __m128i*>(p0);
+        const __m128i* q1 = reinterpret_cast<const __m128i*>(p1);
+        return _mm_sub_epi32(_mm_add_epi32(_mm_loadu_si128(q1), _mm_loadu_si128(q1 + 1)),
+                             _mm_add_epi32(_mm_loadu_si128(q0), _mm_loadu_si128(q0 + 1)));
+    }
+
+    inline __m128i blockSums(const uint16_t* p0, const uint16_t* p1)
+    {
+        __m128i d = _mm_sub_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p1)),
+                                  _mm_loadu_si128(reinterpret_cast<const __m128i*>(p0)));
+        d = _mm_add_epi16(d, _mm_srli_si128(d, 8));
+        return _mm_unpacklo_epi16(d, _mm_setzero_si128());
+    }
+
+    // The rounded average of a block's "sums", given its "scale", with the
+    // channels back in order.  The even and odd lanes are multiplied by the
+    // reciprocal in 64 bits, whose high halves are the quotients.
+
+    inline __m128i average(__m128i sums, const uint32_t* scale)
+    {
+        const __m128i* s = reinterpret_cast<const __m128i*>(scale);
+        const __m128i m = _mm_loadu_si128(s);
+        const __m128i total = _mm_add_epi32(sums, _mm_loadu_si128(s + 1));
+        __m128 even = _mm_castsi128_ps(_mm_mul_epu32(total, m));
+        __m128 odd = _mm_castsi128_ps(_mm_mul_epu32(_mm_srli_epi64(total, 32), m));
+        return _mm_castps_si128(_mm_shuffle_ps(even, odd, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+
+#endif
+
+    // Write the "dstWidth" pixels of one destination row to "dst", each the
+    // rounded average of the source pixels in its block, given the "prefix"
+    // sums of the row's column sums.  The blocks are "rows" high, span the
+    // columns between consecutive elements of "columns", and have the
+    // "scales" laid out above.  If "exact" every block's reciprocal is
+    // usable, so no pixel needs a division.
+
+    template <typename Prefix>
+    void averageColumns(uint8_t* dst, int dstWidth, const Prefix* prefix, int rows,
+                        const int* columns, const uint32_t* scales, bool exact)
+    {
+        int i = 0;
+
+#if defined(__SSE2__)
+
+        if (exact)
+        {
+            const Prefix* p0 = prefix + columns[0] * bytesPerPixel;
+            for (; i + 4 <= dstWidth; i += 4)
+            {
+                __m128i q[4];
+                for (int k = 0; k < 4; ++k)
+                {
+                    const Prefix* p1 = prefix + columns[i + k + 1] * bytesPerPixel;
+                    q[k] = average(blockSums(p0, p1), scales + (i + k) * scaleSize);
+                    p0 = p1;
+                }
+                __m128i packed = _mm_packus_epi16(_mm_packs_epi32(q[0], q[1]),
+                                                  _mm_packs_epi32(q[2], q[3]));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * bytesPerPixel), packed);
+            }
+            for (; i < dstWidth; ++i)
+            {
+                const Prefix* p1 = prefix + columns[i + 1] * bytesPerPixel;
+                __m128i q = average(blockSums(p0, p1), scales + i * scaleSize);
+                q = _mm_packus_epi16(_mm_packs_epi32(q, q), q);
+                int32_t packed = _mm_cvtsi128_si32(q);
+                memcpy(dst + i * bytesPerPixel, &packed, bytesPerPixel);
+                p0 = p1;
+            }
+        }
+
+#else
+
+        (void) exact;
+
+#endif
+
+        for (; i < dstWidth; ++i)
+        {
+            const Prefix* p0 = prefix + columns[i] * bytesPerPixel;
+            const Prefix* p1 = prefix + columns[i + 1] * bytesPerPixel;
+            const uint32_t count = uint32_t((columns[i + 1] - columns[i]) * rows);
+            const uint32_t m = scales[i * scaleSize];
+            for (int k = 0; k < bytesPerPixel; ++k)
+            {
+                int c = channelOrder[k];
+                uint32_t rounded = Prefix(p1[c] + p1[c + bytesPerPixel] -
+                                          p0[c] - p0[c + bytesPerPixel]) + count / 2;
+                dst[i * bytesPerPixel + k] = uint8_t(m ? (uint64_t(rounded) * m) >> 32
+                                                       : rounded / count);
+            }
+        }
+    }
+}
+
+Downsampler::Downsampler()
+{
+}
+
+void Downsampler::downsample(uint8_t* dst, int dstWidth, int dstHeight,
+                             const uint8_t* src, int rowLength,
+                             int x, int y, int width, int height)
+{
+    assert((dstWidth > 0) && (dstWidth <= width));
+    assert((dstHeight > 0) && (dstHeight <= height));
+
+    const int rowBytes = width * bytesPerPixel;
+    const size_t prefixBytes = size_t(rowBytes + 2 * bytesPerPixel);
+    if (_sums.size() < size_t(rowBytes))
+        _sums.resize(rowBytes);
+    uint16_t* sums = &_sums[0];
+
+    // The columns each destination pixel covers are the same on every row.
+
+    _columns.resize(dstWidth + 1);
+    for (int i = 0; i <= dstWidth; ++i)
+        _columns[i] = i * width / dstWidth;
+
+    // Blocks have one of two widths and one of two heights, so there are
+    // only four reciprocals.  The scales are laid out for each height.
+
+    const int blockWidth = width / dstWidth;
+    const int blockHeight = height / dstHeight;
+    _scales.resize(2 * dstWidth * scaleSize);
+    bool exact[2];
+    for (int h = 0; h < 2; ++h)
+    {
+        uint32_t counts[2];
+        uint32_t reciprocals[2];
+        for (int w = 0; w < 2; ++w)
+        {
+            counts[w] = uint32_t((blockWidth + w) * (blockHeight + h));
+            reciprocals[w] = reciprocal(counts[w]);
+        }
+        exact[h] = reciprocals[0] && reciprocals[1];
+
+        uint32_t* scale = &_scales[h * dstWidth * scaleSize];
+        for (int i = 0; i < dstWidth; ++i, scale += scaleSize)
+        {
+            int w = _columns[i + 1] - _columns[i] - blockWidth;
+            for (int k = 0; k < bytesPerPixel; ++k)
+            {
+                scale[k] = reciprocals[w];
+                scale[k + bytesPerPixel] = counts[w] / 2;
+            }
+        }
+    }
+
+    // Usually every block's sums fit in 16 bits, and so can the prefix sums.
+
+    const bool narrow = ((blockWidth + 1) * (blockHeight + 1) <= maxSum16);
+    if (narrow)
+    {
+        if (_narrowPrefix.size() < prefixBytes)
+            _narrowPrefix.resize(prefixBytes);
+    }
+    else if (_prefix.size() < prefixBytes)
+    {
+        _prefix.resize(prefixBytes);
+    }
+
+    const size_t stride = size_t(rowLength) * bytesPerPixel;
+    int y1 = 0;
+    for (int j = 0; j < dstHeight; ++j)
+    {
+        int y0 = y1;
+        y1 = (j + 1) * height / dstHeight;
+        int rows = y1 - y0;
+        const uint32_t* scales = &_scales[(rows - blockHeight) * dstWidth * scaleSize];
+        bool rowExact = exact[rows - blockHeight];
+
+        // Sum the source rows covered by this destination row, column by
+        // column, then average the columns covered by each destination pixel.
+
+        const uint8_t* s0 = src + (size_t(y + y0) * rowLength + x) * bytesPerPixel;
+        uint8_t* d = dst + size_t(j) * dstWidth * bytesPerPixel;
+        if (narrow)
+        {
+            sumRows(sums, s0, stride, rows, rowBytes, &_narrowPrefix[0]);
+            averageColumns(d, dstWidth, &_narrowPrefix[0], rows,
+                           &_columns[0], scales, rowExact);
+        }
+        else if (rows <= maxSum16)
+        {
+            sumRows(sums, s0, stride, rows, rowBytes);
+            prefixSums(&_prefix[0], sums, width);
+            averageColumns(d, dstWidth, &_prefix[0], rows,
+                           &_columns[0], scales, rowExact);
+        }
+        else
+        {
+            // Only a huge reduction needs more than one group of rows, whose
+            // sums need 32 bits.
+
+            _wideSums.assign(rowBytes, 0);
+            for (int r = 0; r < rows; r += maxSum16)
+            {
+                sumRows(sums, s0 + r * stride, stride, std::min(maxSum16, rows - r), rowBytes);
+                for (int k = 0; k < rowBytes; ++k)
+                    _wideSums[k] += sums[k];
+            }
+            prefixSums(&_prefix[0], &_wideSums[0], width);
+            averageColumns(d, dstWidth, &_prefix[0], rows,
+                           &_columns[0], scales, rowExact);
+        }
+    }
+}
+
+const char* Downsampler::instructionSet()
+{
+#if defined(__AVX2__)
+    return "AVX2";
+#elif defined(__SSE2__)
+    return "SSE2";
+#else
+    return "scalar";
+#endif
+}
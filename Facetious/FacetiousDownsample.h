@@ -0,0 +1,82 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// FacetiousDownsample.h
+//
+// Downsampler: Reduces a rectangular region of an RGBA image to a smaller
+// size in a single pass, with a box filter.  The ratio between the sizes
+// need not be a power of two: each destination pixel averages the block of
+// source pixels that it covers, with the blocks' boundaries rounded to
+// whole pixels.
+//
+// Summing the source rows is vectorized with AVX2 or SSE2 when the compiler
+// targets them (e.g., with "-mavx2"), and averaging the columns with SSE2,
+// with scalar fallbacks otherwise.  The averages take each block's total
+// from running sums of the columns, and divide by multiplying with a
+// fixed-point reciprocal.
+//
+
+#ifndef __FacetiousDownsample__
+#define __FacetiousDownsample__
+
+#include <vector>
+#include <stdint.h>
+
+class Downsampler
+{
+public:
+    Downsampler();
+
+    // Reduce the "width" by "height" region at "x", "y" of "src", whose rows
+    // are "rowLength" pixels long, to "dstWidth" by "dstHeight" pixels,
+    // written compactly to "dst".  The destination must be no larger than
+    // the region in either dimension.  Pixels have 4 bytes.
+
+    void                downsample(uint8_t* dst, int dstWidth, int dstHeight,
+                                   const uint8_t* src, int rowLength,
+                                   int x, int y, int width, int height);
+
+    // The name of the instruction set used for the vectorized summing:
+    // "AVX2", "SSE2" or "scalar".
+
+    static const char*  instructionSet();
+
+private:
+
+    // Scratch space kept between calls to avoid reallocation: the column
+    // sums of one destination row, in 16 bits, and in 32 bits when more
+    // than 257 rows are summed; their running (prefix) sums, in 16 bits
+    // when every block's sums fit, and in 32 bits otherwise; the first
+    // source column of each destination column; and, for each of the two
+    // block heights, each destination pixel's fixed-point reciprocal of its
+    // count of source pixels, with half the count, for rounding.
+
+    std::vector<uint16_t> _sums;
+    std::vector<uint32_t> _wideSums;
+    std::vector<uint16_t> _narrowPrefix;
+    std::vector<uint32_t> _prefix;
+    std::vector<int>      _columns;
+    std::vector<uint32_t> _scales;
+};
+
+#endif
@@ -0,0 +1,221 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+//  FacetiousFaceTracker.cpp
+//
+
+#include "FacetiousFaceTracker.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdlib.h>
+
+namespace
+{
+    const int bytesPerPixel = 4;
+
+    // The mean absolute difference in luminance, per sample, at which the
+    // confidence of a match drops to zero.
+
+    const float meanDifferenceMax = 32.0f;
+}
+
+FaceTracker::FaceTracker(int templateSize, int searchSize) :
+    _templateSize(std::max(1, templateSize)),
+    _searchSize(std::max(0, searchSize)), _step(0), _offsetX(0), _offsetY(0)
+{
+}
+
+void FaceTracker::reset()
+{
+    _step = 0;
+}
+
+bool FaceTracker::hasTemplate() const
+{
+    return (_step > 0);
+}
+
+void FaceTracker::setTemplate(const FramePipeline::Frame& frame,
+                              const FramePipeline::Rect& face)
+{
+    // Center the largest square of whole samples that fits in the face.
+
+    _step = std::min(face.width, face.height) / _templateSize;
+    if (_step == 0)
+        return;
+
+    const int templatePixels = _templateSize * _step;
+    _offsetX = (face.width - templatePixels) / 2;
+    _offsetY = (face.height - templatePixels) / 2;
+    _face = face;
+
+    FramePipeline::Rect region(face.x + _offsetX, face.y + _offsetY,
+                               templatePixels, templatePixels);
+    luminance(frame, region, _template);
+}
+
+void FaceTracker::copyTemplate(const FaceTracker& other)
+{
+    _templateSize = other._templateSize;
+    _searchSize = other._searchSize;
+    _step = other._step;
+    _offsetX = other._offsetX;
+    _offsetY = other._offsetY;
+    _face = other._face;
+    _template.assign(other._template.begin(), other._template.end());
+}
+
+float FaceTracker::track(const FramePipeline::Frame& frame,
+                         FramePipeline::Rect& face)
+{
+    if (_step == 0)
+        return 0;
+
+    // The search window extends up to _searchSize samples beyond the
+    // template's last position on each side, but stays in the frame and
+    // aligned to the template's samples.
+
+    const int templatePixels = _templateSize * _step;
+    const int tx = _face.x + _offsetX;
+    const int ty = _face.y + _offsetY;
+    const int left = std::min(_searchSize, tx / _step);
+    const int right = std::min(_searchSize,
+                               (frame.width() - tx - templatePixels) / _step);
+    const int below = std::min(_searchSize, ty / _step);
+    const int above = std::min(_searchSize,
+                               (frame.height() - ty - templatePixels) / _step);
+    if ((tx < 0) || (ty < 0) || (right < 0) || (above < 0))
+        return 0;
+
+    const int windowWidth = left + _templateSize + right;
+    const int windowHeight = below + _templateSize + above;
+    FramePipeline::Rect region(tx - left * _step, ty - below * _step,
+                               windowWidth * _step, windowHeight * _step);
+    luminance(frame, region, _window);
+
+    // Exhaustive search for the smallest sum of absolute differences,
+    // abandoning each candidate once it is worse than the best so far.
+
+    const int n = _templateSize;
+    unsigned bestSum = std::numeric_limits<unsigned>::max();
+    int bestX = left;
+    int bestY = below;
+    for (int oy = 0; oy <= below + above; ++oy)
+    {
+        for (int ox = 0; ox <= left + right; ++ox)
+        {
+            unsigned sum = 0;
+            for (int j = 0; (j < n) && (sum < bestSum); ++j)
+            {
+                const uint8_t* t = &_template[j * n];
+                const uint8_t* w = &_window[(oy + j) * windowWidth + ox];
+                for (int i = 0; i < n; ++i)
+                    sum += abs(int(t[i]) - int(w[i]));
+            }
+            if (sum < bestSum)
+            {
+                bestSum = sum;
+                bestX = ox;
+                bestY = oy;
+            }
+        }
+    }
+
+    _face.x = region.x + bestX * _step - _offsetX;
+    _face.y = region.y + bestY * _step - _offsetY;
+    face = _face;
+
+    float meanDifference = float(bestSum) / (n * n);
+    return std::max(0.0f, 1.0f - meanDifference / meanDifferenceMax);
+}
+
+void FaceTracker::luminance(const FramePipeline::Frame& frame,
+                            const FramePipeline::Rect& region,
+                            std::vector<uint8_t>& lum)
+{
+    const int width = region.width / _step;
+    const int height = region.height / _step;
+
+    // The reduced region, in rows of "rowLength" pixels, and its layout.
+
+    const uint8_t* reduced = 0;
+    int rowLength = width;
+    bool topRowFirst = false;
+    int red = 0;
+    int blue = 2;
+
+    FramePipeline::Pixels src;
+    if (frame.getPixels(src))
+    {
+        // Reduce (or just read) the region straight from the frame's pixels,
+        // in their own layout, with no conversion and no flip.
+
+        const int y = src.topRowFirst ?
+            frame.height() - (region.y + region.height) : region.y;
+        if (_step > 1)
+        {
+            _reducedData.resize(size_t(width) * height * bytesPerPixel);
+            _downsampler.downsample(&_reducedData[0], width, height,
+                                    src.data, src.rowLength,
+                                    region.x, y, region.width, region.height);
+            reduced = &_reducedData[0];
+        }
+        else
+        {
+            reduced = src.data + (size_t(y) * src.rowLength + region.x) * bytesPerPixel;
+            rowLength = src.rowLength;
+        }
+        topRowFirst = src.topRowFirst;
+        if (src.format == FramePipeline::BGRA)
+            std::swap(red, blue);
+    }
+    else
+    {
+        _regionData.resize(size_t(region.width) * region.height * bytesPerPixel);
+        frame.getTextureData(region, &_regionData[0]);
+
+        reduced = &_regionData[0];
+        if (_step > 1)
+        {
+            _reducedData.resize(size_t(width) * height * bytesPerPixel);
+            _downsampler.downsample(&_reducedData[0], width, height,
+                                    &_regionData[0], region.width,
+                                    0, 0, region.width, region.height);
+            reduced = &_reducedData[0];
+        }
+    }
+
+    // Luminance in fixed point, with the Rec. 709 weights, with the bottom
+    // row first.
+
+    lum.resize(size_t(width) * height);
+    for (int j = 0; j < height; ++j)
+    {
+        int row = topRowFirst ? height - 1 - j : j;
+        const uint8_t* p = reduced + size_t(row) * rowLength * bytesPerPixel;
+        uint8_t* l = &lum[size_t(j) * width];
+        for (int i = 0; i < width; ++i, p += bytesPerPixel)
+            l[i] = uint8_t((54 * p[red] + 183 * p[1] + 19 * p[blue]) >> 8);
+    }
+}
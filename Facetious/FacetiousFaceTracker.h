@@ -0,0 +1,116 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// FacetiousFaceTracker.h
+//
+// FaceTracker: A cheap alternative to full face detection for the frames
+// between detections.  It keeps the luminance of the last detected face,
+// reduced to a small square template, and finds the best match for that
+// template by the sum of absolute differences within a window around the
+// face's last position.  The match's quality gives a confidence, so the
+// caller can fall back to full detection when the face is lost.
+//
+// The search is in steps of the template's sample spacing, which for a
+// large face is several pixels.  The stabilization of the face in the
+// FramePipeline smooths out the coarseness.
+//
+
+#ifndef __FacetiousFaceTracker__
+#define __FacetiousFaceTracker__
+
+#include "FacetiousFramePipeline.h"
+#include "FacetiousDownsample.h"
+
+#include <vector>
+#include <stdint.h>
+
+class FaceTracker
+{
+public:
+
+    // The template has "templateSize" by "templateSize" samples, and the
+    // search extends up to "searchSize" samples on each side of the face's
+    // last position.
+
+    FaceTracker(int templateSize = 32, int searchSize = 8);
+
+    // Forget the template.
+
+    void                reset();
+    bool                hasTemplate() const;
+
+    // Take the template from "face" in "frame", and start tracking from
+    // there.  A face smaller than the template is not tracked, which
+    // leaves the tracker without a template.
+
+    void                setTemplate(const FramePipeline::Frame& frame,
+                                    const FramePipeline::Rect& face);
+
+    // Take the template, and the face where it last matched, from "other",
+    // keeping this tracker's own scratch space.  So threads can each track
+    // with their own tracker from a template that they share.
+
+    void                copyTemplate(const FaceTracker& other);
+
+    // Find the template in "frame", near where it was last found, and
+    // return the confidence of the match, from 0 (no resemblance) to 1
+    // (identical).  On return, "face" is the face where the template
+    // matched best, the same size as the face it was taken from.
+
+    float               track(const FramePipeline::Frame& frame,
+                              FramePipeline::Rect& face);
+
+private:
+
+    // Fill "lum" with the luminance of "region" of "frame", reduced by
+    // "_step" in each dimension, which must divide the region's size.
+
+    void                luminance(const FramePipeline::Frame& frame,
+                                  const FramePipeline::Rect& region,
+                                  std::vector<uint8_t>& lum);
+
+    int                 _templateSize;
+    int                 _searchSize;
+
+    // The spacing of the template's samples in pixels, and the position of
+    // the template within the face.
+
+    int                 _step;
+    int                 _offsetX;
+    int                 _offsetY;
+
+    // The face where the template last matched.
+
+    FramePipeline::Rect _face;
+
+    std::vector<uint8_t> _template;
+
+    // Scratch space, kept between calls to avoid reallocation.
+
+    std::vector<uint8_t> _regionData;
+    std::vector<uint8_t> _reducedData;
+    std::vector<uint8_t> _window;
+    Downsampler         _downsampler;
+};
+
+#endif
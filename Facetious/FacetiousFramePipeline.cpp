@@ -0,0 +1,874 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+//  FacetiousFramePipeline.cpp
+//
+
+#include "FacetiousFramePipeline.h"
+#include "FacetiousDownsample.h"
+#include "FacetiousFaceTracker.h"
+#include "FacetiousImagePool.h"
+#include "FacetiousStats.h"
+#include "FacetiousTrace.h"
+#include "FacetiousTripleBuffer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <math.h>
+#include <string.h>
+
+namespace
+{
+    const int bytesPerPixel = 4;
+}
+
+//
+
+FramePipeline::Frame::Frame() :
+    sequence(0)
+{
+}
+
+FramePipeline::Frame::~Frame()
+{
+}
+
+bool FramePipeline::Frame::getPixels(Pixels&) const
+{
+    return false;
+}
+
+FramePipeline::RawFrame::RawFrame(std::shared_ptr<const uint8_t> pixels,
+                                  int width, int height, PixelFormat format) :
+    _pixels(pixels), _width(width), _height(height), _format(format)
+{
+}
+
+int FramePipeline::RawFrame::width() const
+{
+    return _width;
+}
+
+int FramePipeline::RawFrame::height() const
+{
+    return _height;
+}
+
+void FramePipeline::RawFrame::getTextureData(uint8_t* data) const
+{
+    getTextureData(Rect(0, 0, _width, _height), data);
+}
+
+void FramePipeline::RawFrame::getTextureData(const Rect& region,
+                                             uint8_t* data) const
+{
+    // Flip the region to match OpenGL's coordinates: its bottom row is the
+    // frame's row (_height - 1 - region.y) counting from the top.
+
+    const size_t frameRowBytes = size_t(_width) * bytesPerPixel;
+    const size_t regionRowBytes = size_t(region.width) * bytesPerPixel;
+    const uint8_t* src = _pixels.get() +
+        (_height - 1 - region.y) * frameRowBytes + region.x * bytesPerPixel;
+    for (int j = 0; j < region.height; ++j, src -= frameRowBytes)
+    {
+        uint8_t* dst = data + j * regionRowBytes;
+        if (_format == RGBA)
+        {
+            memcpy(dst, src, regionRowBytes);
+        }
+        else
+        {
+            for (int i = 0; i < region.width * bytesPerPixel; i += bytesPerPixel)
+            {
+                dst[i + 0] = src[i + 2];
+                dst[i + 1] = src[i + 1];
+                dst[i + 2] = src[i + 0];
+                dst[i + 3] = src[i + 3];
+            }
+        }
+    }
+}
+
+bool FramePipeline::RawFrame::getPixels(Pixels& pixels) const
+{
+    pixels.data = _pixels.get();
+    pixels.rowLength = _width;
+    pixels.format = _format;
+    pixels.topRowFirst = true;
+    return true;
+}
+
+const uint8_t* FramePipeline::RawFrame::pixels() const
+{
+    return _pixels.get();
+}
+
+FramePipeline::PixelFormat FramePipeline::RawFrame::format() const
+{
+    return _format;
+}
+
+FramePipeline::Detector::~Detector()
+{
+}
+
+FramePipeline::Sink::~Sink()
+{
+}
+
+void FramePipeline::Sink::faceImageReady()
+{
+}
+
+FramePipeline::Source::~Source()
+{
+}
+
+//
+
+class FramePipeline::Imp
+{
+public:
+
+    Imp(Sink* s, DetectorCreator c, int frameWidthMax, int frameHeightMax,
+        int n) :
+        sink(s), detectorCreator(c), frame(0), nextSequence(0),
+        runWorkerThreads(false),
+        imagePool(size_t(frameWidthMax) * frameHeightMax * bytesPerPixel,
+                  std::max(1, n) + 1),
+        trackerSequence(0), templateSequence(0), framesSinceDetection(0),
+        lastAcceptedSequence(0),
+        lastPublishedSequence(0), detectorImageWidthMax(64), stabilize(true),
+        directPixels(true), detectionInterval(1), trackingConfidenceMin(0.5f),
+        framesProcessed(0), framesSkipped(0), framesStale(0), framesTracked(0),
+        bytesConverted(0), bytesNotConverted(0), trace(0)
+    {
+        n = std::max(1, n);
+        for (int i = 0; i < n; ++i)
+            workers.push_back(std::unique_ptr<Worker>(new Worker));
+    }
+
+    struct Worker;
+
+    void                               workerThreadFunc(Worker* worker);
+    bool                               trackFace(Worker* worker,
+                                                 const Frame* frame, Rect& face);
+    void                               restartTracking(Worker* worker,
+                                                       const Frame* frame,
+                                                       const Rect* face);
+    void                               processFrame(Worker* worker,
+                                                    Detector* detector,
+                                                    const Frame* frame);
+
+    Sink*                              sink;
+    DetectorCreator                    detectorCreator;
+
+    // The latest frame from the source, and a condition variable that
+    // tells a worker thread when it is ready.  Each frame gets the next
+    // sequence number, to order the results of the workers.
+
+    std::mutex                         frameMutex;
+    std::condition_variable            frameCond;
+    Frame*                             frame;
+    uint64_t                           nextSequence;
+
+    // Each worker thread has its own detector and its own buffers, so
+    // successive frames can be processed in parallel.  The reduced face
+    // image is built in the worker's buffer, which is swapped into the
+    // triple buffer's back slot when it is published.
+
+    struct Worker
+    {
+        Worker() : thread(0) {}
+        std::thread*                   thread;
+        std::vector<Rect>              faces;
+        std::vector<uint8_t>           faceImagePixels;
+        Downsampler                    downsampler;
+        FaceTracker                    tracker;
+    };
+
+    std::vector<std::unique_ptr<Worker> > workers;
+
+    // For stopping the worker threads.
+
+    std::mutex                         runWorkerThreadsMutex;
+    bool                               runWorkerThreads;
+
+    // The face regions converted from frames go into slabs from a pool
+    // that is allocated up front, with one slab for each worker thread and
+    // one to spare.  The reduced face images are handed from the worker
+    // threads to the thread calling deliver() through a wait-free triple
+    // buffer, each slot of which keeps its pixel buffer for reuse.
+
+    FixedImagePool                     imagePool;
+
+    struct FaceFrame
+    {
+        std::vector<uint8_t>           pixels;
+        FaceImage                      image;
+    };
+
+    TripleBuffer<FaceFrame>            faceFrames;
+
+    // Between full detections, the face is tracked from the last detected
+    // face.  The template and the face's last position are shared by the
+    // workers, and only move forward through the frames: "trackerSequence"
+    // is the frame that last moved them, and "templateSequence" the frame
+    // the template was taken from.  Each worker copies them, and searches
+    // with its own tracker outside the lock.
+
+    std::mutex                         trackerMutex;
+    FaceTracker                        tracker;
+    uint64_t                           trackerSequence;
+    uint64_t                           templateSequence;
+    int                                framesSinceDetection;
+
+    // Serializes the workers' use of the stabilizer and the triple
+    // buffer's back slot.  A worker's result is accepted only if its frame
+    // is newer than the last accepted, and published only if it is newer
+    // than the last published, so face images always appear in capture
+    // order and a slow worker's stale result is dropped.
+
+    std::mutex                         publishMutex;
+    uint64_t                           lastAcceptedSequence;
+    uint64_t                           lastPublishedSequence;
+
+    // Settings that may be changed from other threads.
+
+    std::atomic<int>                   detectorImageWidthMax;
+    std::atomic<bool>                  stabilize;
+    std::atomic<bool>                  directPixels;
+    std::atomic<int>                   detectionInterval;
+    std::atomic<float>                 trackingConfidenceMin;
+
+    // Totals, for measuring the pipeline's work.
+
+    std::atomic<uint64_t>              framesProcessed;
+    std::atomic<uint64_t>              framesSkipped;
+    std::atomic<uint64_t>              framesStale;
+    std::atomic<uint64_t>              framesTracked;
+    std::atomic<uint64_t>              bytesConverted;
+    std::atomic<uint64_t>              bytesNotConverted;
+
+    // Latency histograms and counters for each stage, and the optional
+    // trace of each frame.
+
+    Stats                              stats;
+    std::atomic<FrameTrace*>           trace;
+
+    // The filter for stabilizing the detected face, with its x, y, width
+    // and height in its four lanes.  It is used only with publishMutex
+    // locked.
+
+    Stabilizer                         stabilizer;
+};
+
+//
+
+void FramePipeline::Imp::workerThreadFunc(Worker* worker)
+{
+    // Create the face detector in this thread, so it can be confined to
+    // this thread.
+
+    std::unique_ptr<Detector> detector(detectorCreator());
+
+    bool keepGoing = true;
+    while (keepGoing)
+    {
+        Frame* f = 0;
+
+        {
+            // Wait for a frame from the source.  But stop waiting every
+            // second so the end of the loop can check whether the pipeline
+            // is stopping and wanting the thread to stop.
+
+            std::unique_lock<std::mutex> lock(frameMutex);
+            std::chrono::seconds timeout(1);
+            std::cv_status status(std::cv_status::no_timeout);
+
+            while (!frame && (status == std::cv_status::no_timeout))
+                status = frameCond.wait_for(lock, timeout);
+            if (frame)
+            {
+                f = frame;
+                frame = 0;
+            }
+        }
+
+        if (f)
+        {
+            processFrame(worker, detector.get(), f);
+            delete f;
+        }
+
+        // End this routine if the pipeline is stopping and needs the thread
+        // to stop.
+
+        {
+            std::lock_guard<std::mutex> lock(runWorkerThreadsMutex);
+            if (!runWorkerThreads)
+                keepGoing = false;
+        }
+    }
+}
+
+void FramePipeline::Imp::processFrame(Worker* worker, Detector* detector,
+                                      const Frame* f)
+{
+    // Track the face from the last detection if possible.  Otherwise
+    // detect faces in the frame, and choose the face with the maximum
+    // dimension.  This is the slow part, done in parallel by the workers.
+
+    FrameTrace* tr = trace;
+    const Clock::time_point taken = Clock::now();
+    stats.histogram(Stats::Queue).record(taken - f->captureTime);
+    if (tr)
+        tr->span(Stats::name(Stats::Queue), f->sequence, f->captureTime, taken);
+
+    Rect detectedFace;
+    if (!trackFace(worker, f, detectedFace))
+    {
+        std::vector<Rect>& faces = worker->faces;
+        faces.clear();
+        {
+            StageTimer timer(stats, Stats::Detect, tr, f->sequence);
+            detector->detect(*f, faces);
+        }
+
+        // A detector may report an empty face, which is no face at all.
+        // Rejecting it here keeps it out of the tracker and the stabilizer,
+        // which it would drag toward zero.
+
+        size_t iFaceMaxDim = FramePipeline::largestFace(faces);
+        if ((iFaceMaxDim == faces.size()) || (faces[iFaceMaxDim].width <= 0) ||
+            (faces[iFaceMaxDim].height <= 0))
+        {
+            stats.add(Stats::DetectionsNoFace);
+            if (tr)
+                tr->frameEnd(f->sequence, "no face", Clock::now());
+            restartTracking(worker, f, 0);
+            ++framesProcessed;
+            return;
+        }
+
+        detectedFace = faces[iFaceMaxDim];
+        restartTracking(worker, f, &detectedFace);
+    }
+    ++framesProcessed;
+
+    int imageWidth = f->width();
+    int imageHeight = f->height();
+    int x, y, width, height;
+
+    {
+        // Another worker may have finished a newer frame while this one
+        // was detecting, in which case this result is stale.  Otherwise,
+        // add it to the stabilizer, which then sees the detected faces in
+        // capture order.
+
+        std::lock_guard<std::mutex> lock(publishMutex);
+        if (f->sequence <= lastAcceptedSequence)
+        {
+            ++framesStale;
+            if (tr)
+                tr->frameEnd(f->sequence, "stale", Clock::now());
+            return;
+        }
+        lastAcceptedSequence = f->sequence;
+
+        const float sample[Stabilizer::Lanes] =
+        {
+            float(detectedFace.x), float(detectedFace.y),
+            float(detectedFace.width), float(detectedFace.height)
+        };
+        float filtered[Stabilizer::Lanes];
+        std::chrono::duration<double> time = f->captureTime.time_since_epoch();
+        stabilizer.update(sample, time.count(), filtered);
+
+        // Apply stabilization to the detected face region if requested.
+
+        bool stab = stabilize;
+        x = stab ? int(lroundf(filtered[0])) : detectedFace.x;
+        y = stab ? int(lroundf(filtered[1])) : detectedFace.y;
+        width = stab ? int(lroundf(filtered[2])) : detectedFace.width;
+        height = stab ? int(lroundf(filtered[3])) : detectedFace.height;
+    }
+
+    // The face image is square, so keep that square within the frame.
+
+    width = std::min(width, std::min(imageWidth, imageHeight));
+    height = width;
+    x = std::max(0, std::min(x, imageWidth - width));
+    y = std::max(0, std::min(y, imageHeight - height));
+
+    // An empty frame clamps the face to nothing, leaving nothing to crop.
+    // Record it as no face rather than dividing by its width below.
+
+    if ((width <= 0) || (height <= 0))
+    {
+        stats.add(Stats::DetectionsNoFace);
+        if (tr)
+            tr->frameEnd(f->sequence, "no face", Clock::now());
+        return;
+    }
+
+    Rect face(x, y, width, height);
+
+    // Reduce the face directly from the frame's pixels if it has them in
+    // memory, in their own layout.  Otherwise convert only the face region,
+    // plus a small margin, into texture data in a slab from the pool.  A
+    // region too big for a slab, from a frame bigger than the pipeline was
+    // built for, is skipped, as is a frame for which no slab is free.
+
+    const Clock::time_point reduceStart = Clock::now();
+    const int margin = width / 8;
+    Rect region;
+    region.x = std::max(0, x - margin);
+    region.y = std::max(0, y - margin);
+    region.width = std::min(imageWidth, x + width + margin) - region.x;
+    region.height = std::min(imageHeight, y + height + margin) - region.y;
+    const size_t regionBytes = size_t(region.width) * region.height * bytesPerPixel;
+
+    Pixels src;
+    FixedImagePool::Handle regionImage;
+    if (directPixels && f->getPixels(src))
+    {
+        // Coordinates are relative to the frame's rows in memory.
+
+        if (src.topRowFirst)
+            y = imageHeight - (y + height);
+        bytesNotConverted += regionBytes;
+    }
+    else
+    {
+        if (regionBytes <= imagePool.slabBytes())
+            regionImage = imagePool.alloc();
+        if (!regionImage)
+        {
+            ++framesSkipped;
+            if (tr)
+                tr->frameEnd(f->sequence, "skipped", Clock::now());
+            return;
+        }
+
+        f->getTextureData(region, regionImage.data());
+        bytesConverted += regionBytes;
+
+        // From here on, coordinates are relative to the converted region.
+
+        src.data = regionImage.data();
+        src.rowLength = region.width;
+        src.format = RGBA;
+        src.topRowFirst = false;
+        x -= region.x;
+        y -= region.y;
+    }
+
+    // Build the face image in the worker's own buffer, reducing it to the
+    // maximum requested width.  This width is user settable, but in
+    // general, the results of LuminanceHeightFieldVertexShader look best
+    // when the image is relatively low resolution, like 64 x 64.  The
+    // reduction is done in one pass, directly from the face region, and
+    // keeps the rows in the order of the source.
+
+    const int widthMax = detectorImageWidthMax;
+    int faceImageWidth = std::min(width, widthMax);
+    int faceImageHeight = std::max(1, height * faceImageWidth / width);
+
+    std::vector<uint8_t>& pixels = worker->faceImagePixels;
+    const size_t faceImageRowBytes = size_t(faceImageWidth) * bytesPerPixel;
+    pixels.resize(faceImageRowBytes * faceImageHeight);
+    uint8_t* faceImageData = &pixels[0];
+
+    if (width > widthMax)
+    {
+        worker->downsampler.downsample(faceImageData, faceImageWidth,
+                                       faceImageHeight, src.data,
+                                       src.rowLength, x, y, width, height);
+    }
+    else
+    {
+        for (int j = 0; j < faceImageHeight; ++j)
+            memcpy(faceImageData + j * faceImageRowBytes,
+                   src.data + (size_t(y + j) * src.rowLength + x) * bytesPerPixel,
+                   faceImageRowBytes);
+    }
+
+    regionImage.reset();
+    const Clock::time_point reduceEnd = Clock::now();
+    stats.histogram(Stats::Reduce).record(reduceEnd - reduceStart);
+    if (tr)
+        tr->span(Stats::name(Stats::Reduce), f->sequence, reduceStart, reduceEnd);
+
+    {
+        StageTimer timer(stats, Stats::Publish, tr, f->sequence);
+
+        // Make the detected face available for rendering, unless a worker
+        // has published a newer frame in the meantime.  Swapping the
+        // buffers leaves the worker with the back slot's old buffer to
+        // reuse.
+
+        std::lock_guard<std::mutex> lock(publishMutex);
+        if (f->sequence <= lastPublishedSequence)
+        {
+            ++framesStale;
+            if (tr)
+                tr->frameEnd(f->sequence, "stale", Clock::now());
+            return;
+        }
+        lastPublishedSequence = f->sequence;
+
+        FaceFrame& faceFrame = faceFrames.back();
+        faceFrame.pixels.swap(pixels);
+
+        FaceImage& faceImage = faceFrame.image;
+        faceImage.data = &faceFrame.pixels[0];
+        faceImage.width = faceImageWidth;
+        faceImage.height = faceImageHeight;
+        faceImage.rowLength = faceImageWidth;
+        faceImage.skipPixels = 0;
+        faceImage.skipRows = 0;
+        faceImage.format = src.format;
+        faceImage.topRowFirst = src.topRowFirst;
+        faceImage.face = face;
+        faceImage.captureTime = f->captureTime;
+        faceImage.sequence = f->sequence;
+
+        faceFrames.publish();
+        if (tr)
+            tr->frameEnd(f->sequence, "published", Clock::now());
+    }
+
+    sink->faceImageReady();
+}
+
+bool FramePipeline::Imp::trackFace(Worker* worker, const Frame* f, Rect& face)
+{
+    // Tracking is off if every frame gets a full detection.  Otherwise, a
+    // full detection is due every detectionInterval frames, and when the
+    // tracker has lost the face.
+
+    const int interval = detectionInterval;
+    if (interval <= 1)
+        return false;
+
+    // Copy the template under the lock, and search outside it, so workers
+    // track frames in parallel.  A frame taken out of order is searched
+    // for around the newest position, which is as near as any.
+
+    uint64_t copiedSequence;
+    {
+        std::lock_guard<std::mutex> lock(trackerMutex);
+        if (!tracker.hasTemplate() || (framesSinceDetection + 1 >= interval))
+            return false;
+
+        ++framesSinceDetection;
+        copiedSequence = templateSequence;
+        worker->tracker.copyTemplate(tracker);
+    }
+
+    float confidence;
+    {
+        StageTimer timer(stats, Stats::Track, trace, f->sequence);
+        confidence = worker->tracker.track(*f, face);
+    }
+
+    // A lost face stops the tracking until the next detection, and a match
+    // in a newer frame moves the shared position, unless a detection has
+    // replaced the template in the meantime.
+
+    std::lock_guard<std::mutex> lock(trackerMutex);
+    const bool current = (templateSequence == copiedSequence);
+    if (confidence < trackingConfidenceMin)
+    {
+        if (current)
+            tracker.reset();
+        return false;
+    }
+
+    if (current && (f->sequence > trackerSequence))
+    {
+        trackerSequence = f->sequence;
+        tracker.copyTemplate(worker->tracker);
+    }
+    ++framesTracked;
+    return true;
+}
+
+void FramePipeline::Imp::restartTracking(Worker* worker, const Frame* f,
+                                         const Rect* face)
+{
+    // Start tracking from a newly detected face, or stop tracking if the
+    // detector found no face.  The template is taken outside the lock.  A
+    // worker that finishes detecting after another has tracked a newer
+    // frame leaves the tracker alone.
+
+    if (detectionInterval <= 1)
+        return;
+
+    if (face)
+        worker->tracker.setTemplate(*f, *face);
+
+    std::lock_guard<std::mutex> lock(trackerMutex);
+    if (f->sequence < trackerSequence)
+        return;
+
+    trackerSequence = f->sequence;
+    templateSequence = f->sequence;
+    framesSinceDetection = 0;
+    if (face && worker->tracker.hasTemplate())
+        tracker.copyTemplate(worker->tracker);
+    else
+        tracker.reset();
+}
+
+//
+
+FramePipeline::FramePipeline(Sink* sink, DetectorCreator detectorCreator,
+                             int frameWidthMax, int frameHeightMax,
+                             int workerCount) :
+    _m(new Imp(sink, detectorCreator, frameWidthMax, frameHeightMax,
+               workerCount))
+{
+}
+
+FramePipeline::~FramePipeline()
+{
+    stop();
+
+    delete _m->frame;
+}
+
+void FramePipeline::start()
+{
+    if (_m->workers[0]->thread)
+        return;
+
+    _m->runWorkerThreads = true;
+    for (size_t i = 0; i < _m->workers.size(); ++i)
+    {
+        Imp::Worker* worker = _m->workers[i].get();
+        worker->thread =
+            new std::thread(std::bind(&Imp::workerThreadFunc, _m.get(), worker));
+    }
+}
+
+void FramePipeline::stop()
+{
+    if (!_m->workers[0]->thread)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(_m->runWorkerThreadsMutex);
+        _m->runWorkerThreads = false;
+    }
+
+    for (size_t i = 0; i < _m->workers.size(); ++i)
+    {
+        Imp::Worker* worker = _m->workers[i].get();
+        worker->thread->join();
+        delete worker->thread;
+        worker->thread = 0;
+    }
+}
+
+void FramePipeline::submit(Frame* frame)
+{
+    LatencyHistogram::Timer timer(_m->stats.histogram(Stats::Submit));
+    frame->captureTime = Clock::now();
+    _m->stats.add(Stats::FramesCaptured);
+
+    FrameTrace* trace = _m->trace;
+
+    {
+        std::lock_guard<std::mutex> lock(_m->frameMutex);
+        frame->sequence = ++_m->nextSequence;
+        if (trace)
+            trace->frameBegin(frame->sequence, frame->captureTime);
+        if (_m->frame)
+        {
+            _m->stats.add(Stats::FramesDropped);
+            if (trace)
+                trace->frameEnd(_m->frame->sequence, "dropped", Clock::now());
+            delete _m->frame;
+        }
+        _m->frame = frame;
+    }
+
+    _m->frameCond.notify_one();
+}
+
+bool FramePipeline::deliver()
+{
+    if (_m->faceFrames.update())
+    {
+        const FaceImage& image = _m->faceFrames.front().image;
+        StageTimer timer(_m->stats, Stats::Upload, _m->trace, image.sequence);
+        _m->sink->receiveFaceImage(image);
+        return true;
+    }
+    _m->stats.add(Stats::DeliveriesEmpty);
+    return false;
+}
+
+void FramePipeline::setDetectorImageWidthMax(int w)
+{
+    _m->detectorImageWidthMax = w;
+}
+
+int FramePipeline::detectorImageWidthMax() const
+{
+    return _m->detectorImageWidthMax;
+}
+
+void FramePipeline::setStabilize(bool s)
+{
+    _m->stabilize = s;
+}
+
+bool FramePipeline::stabilize() const
+{
+    return _m->stabilize;
+}
+
+void FramePipeline::setStabilizer(const Stabilizer::Settings& settings)
+{
+    std::lock_guard<std::mutex> lock(_m->publishMutex);
+    _m->stabilizer.setSettings(settings);
+}
+
+Stabilizer::Settings FramePipeline::stabilizer() const
+{
+    std::lock_guard<std::mutex> lock(_m->publishMutex);
+    return _m->stabilizer.settings();
+}
+
+void FramePipeline::setDirectPixels(bool d)
+{
+    _m->directPixels = d;
+}
+
+bool FramePipeline::directPixels() const
+{
+    return _m->directPixels;
+}
+
+void FramePipeline::setDetectionInterval(int n)
+{
+    _m->detectionInterval = n;
+}
+
+int FramePipeline::detectionInterval() const
+{
+    return _m->detectionInterval;
+}
+
+void FramePipeline::setTrackingConfidenceMin(float c)
+{
+    _m->trackingConfidenceMin = c;
+}
+
+float FramePipeline::trackingConfidenceMin() const
+{
+    return _m->trackingConfidenceMin;
+}
+
+int FramePipeline::workerCount() const
+{
+    return int(_m->workers.size());
+}
+
+uint64_t FramePipeline::framesProcessed() const
+{
+    return _m->framesProcessed;
+}
+
+uint64_t FramePipeline::framesSkipped() const
+{
+    return _m->framesSkipped;
+}
+
+uint64_t FramePipeline::framesStale() const
+{
+    return _m->framesStale;
+}
+
+uint64_t FramePipeline::framesTracked() const
+{
+    return _m->framesTracked;
+}
+
+uint64_t FramePipeline::bytesConverted() const
+{
+    return _m->bytesConverted;
+}
+
+uint64_t FramePipeline::bytesNotConverted() const
+{
+    return _m->bytesNotConverted;
+}
+
+Stats& FramePipeline::stats()
+{
+    return _m->stats;
+}
+
+const Stats& FramePipeline::stats() const
+{
+    return _m->stats;
+}
+
+void FramePipeline::setTrace(FrameTrace* trace)
+{
+    _m->trace = trace;
+}
+
+FrameTrace* FramePipeline::trace() const
+{
+    return _m->trace;
+}
+
+const FixedImagePool& FramePipeline::imagePool() const
+{
+    return _m->imagePool;
+}
+
+size_t FramePipeline::largestFace(const std::vector<Rect>& faces)
+{
+    float maxDim = 0;
+    size_t iFaceMaxDim = faces.size();
+    for (size_t i = 0; i < faces.size(); ++i)
+    {
+        float dim = (faces[i].width > faces[i].height) ?
+            faces[i].width : faces[i].height;
+        if ((dim > maxDim) || (iFaceMaxDim == faces.size()))
+        {
+            maxDim = dim;
+            iFaceMaxDim = i;
+        }
+    }
+    return iFaceMaxDim;
+}
@@ -0,0 +1,351 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// FacetiousFramePipeline.h
+//
+// FramePipeline: The platform-neutral core of the Facetious video processing.
+// A FramePipeline::Source submits captured frames, and a pool of detector
+// worker threads finds the largest face in each of the latest frames with a
+// FramePipeline::Detector, then crops and reduces the face region and
+// publishes it, in the order the frames were captured.  The rendering
+// thread calls deliver() to hand the latest face image to a
+// FramePipeline::Sink.  None of this code depends on Cocoa, AVFoundation or
+// OpenGL, so the pipeline can be driven headlessly for profiling.
+//
+// FramePipeline::RawFrame: A frame over a buffer of RGBA pixels in memory,
+// used by sources that do not come from a camera.
+//
+
+#ifndef __FacetiousFramePipeline__
+#define __FacetiousFramePipeline__
+
+#include "FacetiousStabilizer.h"
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <stdint.h>
+
+class FixedImagePool;
+class FrameTrace;
+class Stats;
+
+class FramePipeline
+{
+public:
+
+    typedef std::chrono::steady_clock Clock;
+
+    // A rectangle in frame coordinates.  As with Aoc::CppCIDetector::Face,
+    // the origin is at the lower left of the frame.
+
+    struct Rect
+    {
+        Rect(int x0 = 0, int y0 = 0, int w = 0, int h = 0) :
+            x(x0), y(y0), width(w), height(h) {}
+        int             x;
+        int             y;
+        int             width;
+        int             height;
+    };
+
+    // The order of the bytes of a pixel in memory.  BGRA is the native
+    // layout of camera buffers on OS X.
+
+    enum PixelFormat
+    {
+        RGBA,
+        BGRA
+    };
+
+    // Pixels that a frame holds in memory, in a layout the pipeline can
+    // read directly: rows of "rowLength" pixels, with 4 bytes each.
+
+    struct Pixels
+    {
+        Pixels() : data(0), rowLength(0), format(RGBA), topRowFirst(true) {}
+        const uint8_t*  data;
+        int             rowLength;
+        PixelFormat     format;
+        bool            topRowFirst;
+    };
+
+    // A captured frame.  Derived classes wrap the platform's image
+    // representation.
+
+    class Frame
+    {
+    public:
+        Frame();
+        virtual ~Frame();
+
+        virtual int     width() const = 0;
+        virtual int     height() const = 0;
+
+        // Fill "data", allocated by the caller with width() * height() * 4
+        // bytes, with RGBA pixels.  The bottom row of the frame comes first,
+        // to match OpenGL's coordinates.
+
+        virtual void    getTextureData(uint8_t* data) const = 0;
+
+        // Fill "data", allocated by the caller with region.width *
+        // region.height * 4 bytes, with RGBA pixels of only "region" of the
+        // frame, again with the bottom row first.  The region must be
+        // within the frame.
+
+        virtual void    getTextureData(const Rect& region, uint8_t* data) const = 0;
+
+        // If the frame's pixels are in memory in a layout described by
+        // Pixels, set "pixels" to refer to them and return true, so the
+        // face can be reduced from them without converting it first.  The
+        // pixels must stay valid as long as the frame.  The default returns
+        // false.  Called only by the worker thread processing the frame.
+
+        virtual bool    getPixels(Pixels& pixels) const;
+
+        // The time at which FramePipeline::submit() received the frame, and
+        // its position in the sequence of submitted frames, starting at 1.
+
+        Clock::time_point captureTime;
+        uint64_t        sequence;
+    };
+
+    // A concrete frame over RGBA or BGRA pixels in memory, with the top row
+    // first (the usual order for image files and camera buffers).  The
+    // frame shares ownership of the pixels, so many frames can refer to the
+    // same data without copying it.  getTextureData() always produces RGBA.
+
+    class RawFrame : public Frame
+    {
+    public:
+        RawFrame(std::shared_ptr<const uint8_t> pixels, int width, int height,
+                 PixelFormat format = RGBA);
+
+        virtual int     width() const;
+        virtual int     height() const;
+        virtual void    getTextureData(uint8_t* data) const;
+        virtual void    getTextureData(const Rect& region, uint8_t* data) const;
+        virtual bool    getPixels(Pixels& pixels) const;
+
+        // Direct access to the pixels, with the top row first.
+
+        const uint8_t*  pixels() const;
+        PixelFormat     format() const;
+
+    private:
+        std::shared_ptr<const uint8_t> _pixels;
+        int             _width;
+        int             _height;
+        PixelFormat     _format;
+    };
+
+    // The face detector.  An instance is created by each worker thread and
+    // used only from that thread, so implementations do not need to be
+    // thread safe.
+
+    class Detector
+    {
+    public:
+        virtual ~Detector();
+        virtual void    detect(const Frame& frame, std::vector<Rect>& faces) = 0;
+    };
+
+    typedef std::function<Detector* ()> DetectorCreator;
+
+    // A reduced image of the detected face, as published by the detector
+    // thread.  The arguments to upload it as a texture are the same as for
+    // Agl::TextureUbyte::setData(): the face occupies "width" by "height"
+    // pixels of "data", starting "skipPixels" pixels and "skipRows" rows in,
+    // with rows "rowLength" pixels long.
+
+    struct FaceImage
+    {
+        const uint8_t*  data;
+        int             width;
+        int             height;
+        int             rowLength;
+        int             skipPixels;
+        int             skipRows;
+
+        // The layout of the pixels.  When the frame's pixels could be read
+        // directly, the face image keeps their layout rather than paying
+        // for a conversion, so it may be BGRA, and it may have the top row
+        // first, in which case the renderer should flip the image's t
+        // texture coordinate.
+
+        PixelFormat     format;
+        bool            topRowFirst;
+
+        // The face's region in the original frame, and the time that frame
+        // was captured and its sequence number.
+
+        Rect            face;
+        Clock::time_point captureTime;
+        uint64_t        sequence;
+    };
+
+    // The consumer of face images.
+
+    class Sink
+    {
+    public:
+        virtual ~Sink();
+
+        // Called from a worker thread when a new face image has been
+        // published, for example to request a redraw.  Must be thread safe
+        // if there is more than one worker.
+
+        virtual void    faceImageReady();
+
+        // Called from deliver(), in the thread that called it, with the
+        // latest face image.  The image data is valid only during the call.
+
+        virtual void    receiveFaceImage(const FaceImage& image) = 0;
+    };
+
+    // The producer of frames, like a camera.
+
+    class Source
+    {
+    public:
+        virtual ~Source();
+
+        // Start calling FramePipeline::submit() on "pipeline" with frames,
+        // from any thread.
+
+        virtual void    start(FramePipeline* pipeline) = 0;
+        virtual void    stop() = 0;
+    };
+
+    // The pipeline does not own the sink.  It calls the creator from each
+    // of the "workerCount" worker threads to create that thread's detector.
+    // All the memory for converting frames is allocated here, for frames up
+    // to "frameWidthMax" by "frameHeightMax".
+
+    FramePipeline(Sink* sink, DetectorCreator detectorCreator,
+                  int frameWidthMax = 1920, int frameHeightMax = 1080,
+                  int workerCount = 1);
+    ~FramePipeline();
+
+    // Start and stop the worker threads.
+
+    void                start();
+    void                stop();
+
+    // Make "frame" the latest frame, taking ownership of it.  A previous
+    // frame that no worker thread has yet taken is discarded.
+    // May be called from any thread.
+
+    void                submit(Frame* frame);
+
+    // If a new face image has been published, pass the newest one to the
+    // sink's receiveFaceImage() and return true.  Never blocks on the
+    // worker threads.  Must be called from only one thread at a time.
+
+    bool                deliver();
+
+    // The maximum width of a published face image.  Larger faces are
+    // reduced to this width.
+
+    void                setDetectorImageWidthMax(int);
+    int                 detectorImageWidthMax() const;
+
+    // Whether to stabilize the detected face, and the filter that does it
+    // (by default a OneEuro filter).  Changing the filter restarts it.
+
+    void                setStabilize(bool);
+    bool                stabilize() const;
+    void                setStabilizer(const Stabilizer::Settings&);
+    Stabilizer::Settings stabilizer() const;
+
+    // Whether to reduce the face directly from the pixels of frames whose
+    // getPixels() provides them (the default), rather than first converting
+    // the face region to RGBA with the bottom row first.
+
+    void                setDirectPixels(bool);
+    bool                directPixels() const;
+
+    // Between full detections, the face can be tracked from the last
+    // detected face, which is much cheaper.  A full detection is done on
+    // every "detectionInterval" frames, or every frame if it is 1 (the
+    // default), and also whenever the tracker's confidence in its match
+    // falls below "trackingConfidenceMin", from 0 to 1 (default 0.5).
+
+    void                setDetectionInterval(int);
+    int                 detectionInterval() const;
+    void                setTrackingConfidenceMin(float);
+    float               trackingConfidenceMin() const;
+
+    // The number of worker threads.
+
+    int                 workerCount() const;
+
+    // The number of frames the workers have processed, the number of those
+    // in which the face was tracked rather than detected, the number skipped
+    // for lack of memory to convert them, the number dropped because a
+    // worker finished a newer frame first, and the number of bytes of
+    // texture data converted from them.  Only the face region of a frame,
+    // plus a small margin, is converted, and none of it when the frame's
+    // pixels can be read directly; the bytes that would have been converted
+    // then are counted by bytesNotConverted().
+
+    uint64_t            framesProcessed() const;
+    uint64_t            framesTracked() const;
+    uint64_t            framesSkipped() const;
+    uint64_t            framesStale() const;
+    uint64_t            bytesConverted() const;
+    uint64_t            bytesNotConverted() const;
+
+    // The pool of memory for converting frames, for its statistics.
+
+    const FixedImagePool& imagePool() const;
+
+    // Latency histograms and counters for the stages run by the pipeline,
+    // from submit() through deliver().  The caller may record the stages
+    // that follow, like drawing, into the same object.
+
+    Stats&              stats();
+    const Stats&        stats() const;
+
+    // If "trace" is not null, also record each frame's stages, and the
+    // outcome of its processing, in it.  The pipeline does not own the
+    // trace, which must outlive the pipeline's use of it.
+
+    void                setTrace(FrameTrace* trace);
+    FrameTrace*         trace() const;
+
+    // The index of the face with the largest dimension, or faces.size()
+    // if "faces" is empty.
+
+    static size_t       largestFace(const std::vector<Rect>& faces);
+
+private:
+
+    // Details of the class' data are hidden in the .cpp file.
+
+    class Imp;
+    std::unique_ptr<Imp> _m;
+};
+
+#endif
@@ -0,0 +1,192 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+//  FacetiousFrameScheduler.cpp
+//
+
+#include "FacetiousFrameScheduler.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+class FrameScheduler::Imp
+{
+public:
+    Imp(std::function<void ()> r, std::function<bool ()> a, double fps) :
+        redraw(r), animating(a), rate(fps), thread(0), runThread(false),
+        pending(false), frames(0), requestsCoalesced(0), deadlinesMissed(0),
+        latenessTotalUs(0), latenessMaxUs(0), wakeups(0) {}
+
+    void                               threadFunc();
+    Clock::duration                    period() const;
+
+    std::function<void ()>             redraw;
+    std::function<bool ()>             animating;
+
+    // The mutex protects all the data below, and the condition variable
+    // wakes the thread early when it is stopping.
+
+    mutable std::mutex                 mutex;
+    std::condition_variable            cond;
+
+    double                             rate;
+    std::thread*                       thread;
+    bool                               runThread;
+    bool                               pending;
+
+    uint64_t                           frames;
+    uint64_t                           requestsCoalesced;
+    uint64_t                           deadlinesMissed;
+    double                             latenessTotalUs;
+    double                             latenessMaxUs;
+    uint64_t                           wakeups;
+};
+
+FrameScheduler::Clock::duration FrameScheduler::Imp::period() const
+{
+    double fps = std::max(1.0, rate);
+    return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / fps));
+}
+
+void FrameScheduler::Imp::threadFunc()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    Clock::time_point deadline = Clock::now() + period();
+
+    while (runThread)
+    {
+        // Wait for the deadline, unless the scheduler is stopped first.
+
+        while (runThread && (cond.wait_until(lock, deadline) != std::cv_status::timeout))
+            ;
+        if (!runThread)
+            break;
+
+        // Deadlines that passed while this thread was not running are
+        // missed.  The next deadline is the first one still ahead, so the
+        // schedule keeps its phase without catching up.
+
+        Clock::time_point now = std::max(Clock::now(), deadline);
+        const Clock::duration p = period();
+        double latenessUs =
+            std::chrono::duration_cast<std::chrono::duration<double, std::micro> >(now - deadline).count();
+        latenessTotalUs += latenessUs;
+        latenessMaxUs = std::max(latenessMaxUs, latenessUs);
+        ++wakeups;
+
+        uint64_t late = uint64_t((now - deadline) / p);
+        deadlinesMissed += late;
+        deadline += p * (late + 1);
+
+        // Ask the animation whether it needs a frame, and issue the redraw,
+        // without holding the lock, so requests are not blocked meanwhile.
+
+        bool due = pending;
+        pending = false;
+        lock.unlock();
+
+        if (!due && animating)
+            due = animating();
+        if (due)
+            redraw();
+
+        lock.lock();
+        if (due)
+            ++frames;
+    }
+}
+
+//
+
+FrameScheduler::FrameScheduler(std::function<void ()> redraw,
+                               std::function<bool ()> animating, double rate) :
+    _m(new Imp(redraw, animating, rate))
+{
+}
+
+FrameScheduler::~FrameScheduler()
+{
+    stop();
+}
+
+void FrameScheduler::start()
+{
+    std::lock_guard<std::mutex> lock(_m->mutex);
+    if (_m->thread)
+        return;
+    _m->runThread = true;
+    _m->thread = new std::thread(std::bind(&Imp::threadFunc, _m.get()));
+}
+
+void FrameScheduler::stop()
+{
+    std::thread* thread = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(_m->mutex);
+        thread = _m->thread;
+        _m->thread = 0;
+        _m->runThread = false;
+    }
+
+    if (thread)
+    {
+        _m->cond.notify_all();
+        thread->join();
+        delete thread;
+    }
+}
+
+void FrameScheduler::setRate(double r)
+{
+    std::lock_guard<std::mutex> lock(_m->mutex);
+    _m->rate = r;
+}
+
+double FrameScheduler::rate() const
+{
+    std::lock_guard<std::mutex> lock(_m->mutex);
+    return _m->rate;
+}
+
+void FrameScheduler::requestFrame()
+{
+    std::lock_guard<std::mutex> lock(_m->mutex);
+    if (_m->pending)
+        ++_m->requestsCoalesced;
+    _m->pending = true;
+}
+
+FrameScheduler::Stats FrameScheduler::stats() const
+{
+    std::lock_guard<std::mutex> lock(_m->mutex);
+    Stats s;
+    s.frames = _m->frames;
+    s.requestsCoalesced = _m->requestsCoalesced;
+    s.deadlinesMissed = _m->deadlinesMissed;
+    s.latenessMeanUs = _m->wakeups ? _m->latenessTotalUs / _m->wakeups : 0;
+    s.latenessMaxUs = _m->latenessMaxUs;
+    return s;
+}
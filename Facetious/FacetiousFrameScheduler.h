@@ -0,0 +1,102 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// FacetiousFrameScheduler.h
+//
+// FrameScheduler: Paces redraws at a target rate from its own thread.
+// Frames are due at absolute deadlines, a whole number of periods after
+// the start, so the rate does not drift however long each wait takes.  At
+// each deadline there is at most one redraw, however many requests came
+// in since the last one: from the detector when a new face is ready, from
+// the keyboard, or because the animation is running.  A deadline that has
+// passed by the time the thread wakes is counted as missed, and the
+// schedule skips ahead rather than issuing a burst of late redraws.
+//
+// The scheduler depends only on the C++ standard library, so it can be
+// used by the headless driver.
+//
+
+#ifndef __FacetiousFrameScheduler__
+#define __FacetiousFrameScheduler__
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <stdint.h>
+
+class FrameScheduler
+{
+public:
+
+    typedef std::chrono::steady_clock Clock;
+
+    // At a deadline, "redraw" is called from the scheduler's thread if a
+    // frame has been requested, or if "animating" (when given) returns
+    // true.  The target rate is "rate" frames per second.
+
+    FrameScheduler(std::function<void ()> redraw,
+                   std::function<bool ()> animating = std::function<bool ()>(),
+                   double rate = 30.0);
+    ~FrameScheduler();
+
+    // Start and stop the scheduler's thread.
+
+    void                start();
+    void                stop();
+
+    // Set and get the target rate, in frames per second.  A change takes
+    // effect at the next deadline.
+
+    void                setRate(double);
+    double              rate() const;
+
+    // Request a redraw at the next deadline.  May be called from any
+    // thread.
+
+    void                requestFrame();
+
+    // Statistics: the number of redraws issued, the number of requests
+    // merged into a redraw already pending, the number of deadlines missed
+    // entirely, and the mean and maximum lateness of the thread's wakeups
+    // relative to their deadlines, in microseconds.
+
+    struct Stats
+    {
+        uint64_t        frames;
+        uint64_t        requestsCoalesced;
+        uint64_t        deadlinesMissed;
+        double          latenessMeanUs;
+        double          latenessMaxUs;
+    };
+
+    Stats               stats() const;
+
+private:
+
+    // Details of the class' data are hidden in the .cpp file.
+
+    class Imp;
+    std::unique_ptr<Imp> _m;
+};
+
+#endif
@@ -0,0 +1,109 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+//  FacetiousFramebuffer.cpp
+//
+
+#include "FacetiousFramebuffer.h"
+
+#include <stdexcept>
+
+Framebuffer::Framebuffer() :
+    _id(0), _color(0), _depth(0), _width(0), _height(0)
+{
+    glGenFramebuffers(1, &_id);
+    glGenRenderbuffers(1, &_color);
+    glGenRenderbuffers(1, &_depth);
+}
+
+Framebuffer::~Framebuffer()
+{
+    glDeleteRenderbuffers(1, &_depth);
+    glDeleteRenderbuffers(1, &_color);
+    glDeleteFramebuffers(1, &_id);
+}
+
+void Framebuffer::resize(GLsizei width, GLsizei height)
+{
+    if ((width == _width) && (height == _height))
+        return;
+    _width = width;
+    _height = height;
+
+    glBindRenderbuffer(GL_RENDERBUFFER, _color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, _depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    GLint previous = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous);
+    glBindFramebuffer(GL_FRAMEBUFFER, _id);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                              GL_RENDERBUFFER, _color);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                              GL_RENDERBUFFER, _depth);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, previous);
+
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+        throw std::runtime_error("Framebuffer::resize(): framebuffer incomplete");
+}
+
+GLsizei Framebuffer::width() const
+{
+    return _width;
+}
+
+GLsizei Framebuffer::height() const
+{
+    return _height;
+}
+
+void Framebuffer::bind()
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, _id);
+}
+
+void Framebuffer::unbind(GLuint windowId)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, windowId);
+}
+
+void Framebuffer::present(GLuint windowId)
+{
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, _id);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, windowId);
+    glBlitFramebuffer(0, 0, _width, _height, 0, 0, _width, _height,
+                      GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, windowId);
+}
+
+void Framebuffer::readPixels(GLubyte* data)
+{
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, _id);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+    glReadPixels(0, 0, _width, _height, GL_RGBA, GL_UNSIGNED_BYTE, data);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+}
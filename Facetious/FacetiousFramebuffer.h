@@ -0,0 +1,78 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// FacetiousFramebuffer.h
+//
+// Framebuffer: An OpenGL framebuffer object with color and depth
+// renderbuffers, for rendering a frame offscreen.  The frame can then be
+// copied to the window's framebuffer as often as needed, which is much
+// cheaper than rendering it again, or read back into memory.
+//
+
+#ifndef __FacetiousFramebuffer__
+#define __FacetiousFramebuffer__
+
+#include <OpenGL/gl3.h>
+
+class Framebuffer
+{
+public:
+
+    // Must be called with the OpenGL context current, as must all the
+    // other routines.
+
+    Framebuffer();
+    ~Framebuffer();
+
+    // Set the size, reallocating the renderbuffers only if it changed.
+    // Throws an exception if the framebuffer is incomplete.
+
+    void                resize(GLsizei width, GLsizei height);
+
+    GLsizei             width() const;
+    GLsizei             height() const;
+
+    // Make this framebuffer the target of rendering, or restore the
+    // window's framebuffer, "windowId" (0 by default), as the target.
+
+    void                bind();
+    void                unbind(GLuint windowId = 0);
+
+    // Copy the color buffer to the window's framebuffer.
+
+    void                present(GLuint windowId = 0);
+
+    // Read the color buffer into "data", allocated by the caller with
+    // width() * height() * 4 bytes, as RGBA with the bottom row first.
+
+    void                readPixels(GLubyte* data);
+
+private:
+    GLuint              _id;
+    GLuint              _color;
+    GLuint              _depth;
+    GLsizei             _width;
+    GLsizei             _height;
+};
+
+#endif
@@ -0,0 +1,411 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+//  FacetiousHeightField.cpp
+//
+
+#include "FacetiousHeightField.h"
+
+#include <algorithm>
+#include <math.h>
+
+namespace
+{
+    const int bytesPerPixel = 4;
+
+    // The Rec. 709 luminance weights, as in the shader.
+
+    const float lumR = 0.2126f;
+    const float lumG = 0.7152f;
+    const float lumB = 0.0722f;
+
+    // The fraction of the surface over which the edge weight falls to 0.
+
+    const float edgeWidth = 0.1f;
+
+    float edgeWeight(float s, float t)
+    {
+        return std::min(s / edgeWidth, 1.0f) *
+            std::min((1.0f - s) / edgeWidth, 1.0f) *
+            std::min(t / edgeWidth, 1.0f) *
+            std::min((1.0f - t) / edgeWidth, 1.0f);
+    }
+
+    // Like the GLSL texture() function, for an RGBA texture with linear
+    // filtering and GL_CLAMP_TO_EDGE wrapping.  The offset is in texels, as
+    // with textureOffset().
+
+    void sampleRGBA(const uint8_t* data, int width, int height, float s,
+                    float t, int offsetS, int offsetT, float rgba[4])
+    {
+        float u = s * width - 0.5f + offsetS;
+        float v = t * height - 0.5f + offsetT;
+        float u0 = floorf(u);
+        float v0 = floorf(v);
+        float fu = u - u0;
+        float fv = v - v0;
+        int i0 = std::max(0, std::min(int(u0), width - 1));
+        int i1 = std::max(0, std::min(int(u0) + 1, width - 1));
+        int j0 = std::max(0, std::min(int(v0), height - 1));
+        int j1 = std::max(0, std::min(int(v0) + 1, height - 1));
+
+        const uint8_t* p00 = data + (j0 * width + i0) * bytesPerPixel;
+        const uint8_t* p10 = data + (j0 * width + i1) * bytesPerPixel;
+        const uint8_t* p01 = data + (j1 * width + i0) * bytesPerPixel;
+        const uint8_t* p11 = data + (j1 * width + i1) * bytesPerPixel;
+        for (int c = 0; c < 4; ++c)
+        {
+            float bottom = p00[c] + fu * (p10[c] - p00[c]);
+            float top = p01[c] + fu * (p11[c] - p01[c]);
+            rgba[c] = (bottom + fv * (top - bottom)) / 255.0f;
+        }
+    }
+
+    float luminance(const float rgba[4])
+    {
+        return lumR * rgba[0] + lumG * rgba[1] + lumB * rgba[2];
+    }
+
+    // The three loops of HeightField::warp().  They are functions so that
+    // the compiler honors the "__restrict" qualifiers on their arguments,
+    // which tell it that the arrays do not overlap.
+
+    // Find the lower left of the texels that bilinear filtering uses for
+    // each vertex, and the fractions for blending them.
+
+    void findTexels(const float* __restrict s, const float* __restrict t,
+                    size_t n, int width, int height, int* __restrict columns,
+                    int* __restrict rows, float* __restrict fractionS,
+                    float* __restrict fractionT)
+    {
+        const float w = float(width);
+        const float h = float(height);
+        for (size_t k = 0; k < n; ++k)
+        {
+            // Texture coordinates are not negative, so truncating u + 1 and
+            // v + 1 gives the floor of u and v without a call to floorf().
+
+            const float u = s[k] * w - 0.5f;
+            const float v = t[k] * h - 0.5f;
+            const int iu = int(u + 1.0f) - 1;
+            const int iv = int(v + 1.0f) - 1;
+            fractionS[k] = u - float(iu);
+            fractionT[k] = v - float(iv);
+            columns[k] = iu;
+            rows[k] = iv;
+        }
+    }
+
+    // Filter the luminance at each vertex and one texel over in s and in t.
+    // Those samples share columns iu to iu + 2 and rows iv to iv + 2 of
+    // texels, clamped to the edges.
+
+    void filterLuminance(const float* __restrict lum, int width, int height,
+                         const int* __restrict columns,
+                         const int* __restrict rows,
+                         const float* __restrict fractionS,
+                         const float* __restrict fractionT, size_t n,
+                         float* __restrict h, float* __restrict hdx,
+                         float* __restrict hdy)
+    {
+        for (size_t k = 0; k < n; ++k)
+        {
+            const int iu = columns[k];
+            const int iv = rows[k];
+            const int i0 = std::max(0, std::min(iu, width - 1));
+            const int i1 = std::max(0, std::min(iu + 1, width - 1));
+            const int i2 = std::max(0, std::min(iu + 2, width - 1));
+            const int r0 = std::max(0, std::min(iv, height - 1)) * width;
+            const int r1 = std::max(0, std::min(iv + 1, height - 1)) * width;
+            const int r2 = std::max(0, std::min(iv + 2, height - 1)) * width;
+
+            const float l00 = lum[r0 + i0], l10 = lum[r0 + i1], l20 = lum[r0 + i2];
+            const float l01 = lum[r1 + i0], l11 = lum[r1 + i1], l21 = lum[r1 + i2];
+            const float l02 = lum[r2 + i0], l12 = lum[r2 + i1];
+
+            const float fu = fractionS[k];
+            const float fv = fractionT[k];
+            const float b0 = l00 + fu * (l10 - l00);
+            const float b1 = l01 + fu * (l11 - l01);
+            const float b2 = l02 + fu * (l12 - l02);
+            const float bx0 = l10 + fu * (l20 - l10);
+            const float bx1 = l11 + fu * (l21 - l11);
+
+            h[k] = b0 + fv * (b1 - b0);
+            hdx[k] = bx0 + fv * (bx1 - bx0);
+            hdy[k] = b1 + fv * (b2 - b1);
+        }
+    }
+
+    // Weight the heights, displace the vertices and compute the normals,
+    // from the cross product of (texelWidthS, 0, hdx - h) and
+    // (0, texelWidthT, hdy - h).  The unweighted heights come in "outZ",
+    // "outNx" and "outNy".
+
+    void displace(const float* __restrict inX, const float* __restrict inY,
+                  const float* __restrict inZ, const float* __restrict inS,
+                  const float* __restrict inT, size_t n, float heightScale,
+                  float texelWidthS, float texelWidthT,
+                  float* __restrict outX, float* __restrict outY,
+                  float* __restrict outZ, float* __restrict outNx,
+                  float* __restrict outNy, float* __restrict outNz,
+                  float* __restrict outS, float* __restrict outT)
+    {
+        const float nz = texelWidthS * texelWidthT;
+        for (size_t k = 0; k < n; ++k)
+        {
+            const float s = inS[k];
+            const float t = inT[k];
+            const float weight = edgeWeight(s, t) * heightScale;
+            const float h = weight * outZ[k];
+            const float hdx = weight * outNx[k];
+            const float hdy = weight * outNy[k];
+
+            const float cx = -(hdx - h) * texelWidthT;
+            const float cy = -(hdy - h) * texelWidthS;
+            const float invLength = 1.0f / sqrtf(cx * cx + cy * cy + nz * nz);
+
+            outX[k] = inX[k];
+            outY[k] = inY[k];
+            outZ[k] = inZ[k] + h;
+            outNx[k] = cx * invLength;
+            outNy[k] = cy * invLength;
+            outNz[k] = nz * invLength;
+            outS[k] = s;
+            outT[k] = t;
+        }
+    }
+}
+
+//
+
+void HeightField::Vertices::resize(size_t n)
+{
+    x.resize(n);
+    y.resize(n);
+    z.resize(n);
+    nx.resize(n);
+    ny.resize(n);
+    nz.resize(n);
+    s.resize(n);
+    t.resize(n);
+}
+
+size_t HeightField::Vertices::size() const
+{
+    return x.size();
+}
+
+void HeightField::makeGrid(int resX, int resY, Vertices& grid)
+{
+    grid.resize(size_t(resX) * resY);
+    size_t k = 0;
+    for (int j = 0; j < resY; ++j)
+    {
+        float t = (resY > 1) ? float(j) / (resY - 1) : 0.5f;
+        for (int i = 0; i < resX; ++i, ++k)
+        {
+            float s = (resX > 1) ? float(i) / (resX - 1) : 0.5f;
+            grid.x[k] = 2 * s - 1;
+            grid.y[k] = 2 * t - 1;
+            grid.z[k] = 0;
+            grid.nx[k] = 0;
+            grid.ny[k] = 0;
+            grid.nz[k] = 1;
+            grid.s[k] = s;
+            grid.t[k] = t;
+        }
+    }
+}
+
+HeightField::HeightField() :
+    _heightScale(1 / 3.0f), _data(0), _width(0), _height(0)
+{
+}
+
+void HeightField::setHeightScale(float s)
+{
+    _heightScale = s;
+}
+
+float HeightField::heightScale() const
+{
+    return _heightScale;
+}
+
+void HeightField::setTexture(const uint8_t* data, int width, int height)
+{
+    _data = data;
+    _width = width;
+    _height = height;
+
+    // Filtering is linear, and so is luminance, so filtering the luminance
+    // gives the same result as the luminance of the filtered color.
+
+    _luminance.resize(size_t(width) * height);
+    const float scale = 1 / 255.0f;
+    for (size_t k = 0; k < _luminance.size(); ++k, data += bytesPerPixel)
+        _luminance[k] = (lumR * data[0] + lumG * data[1] + lumB * data[2]) * scale;
+}
+
+void HeightField::warp(const Vertices& in, float texelWidthS,
+                       float texelWidthT, Vertices& out) const
+{
+    const size_t n = in.size();
+    out.resize(n);
+    if ((n == 0) || _luminance.empty())
+        return;
+
+    // The work is split into three loops so that the first and last, which
+    // do most of the arithmetic, have no indirect loads and can be
+    // vectorized.  The unweighted heights pass from the second loop to the
+    // third in the output's z and normal arrays.
+
+    _columns.resize(n);
+    _rows.resize(n);
+    _fractionS.resize(n);
+    _fractionT.resize(n);
+
+    findTexels(&in.s[0], &in.t[0], n, _width, _height, &_columns[0],
+               &_rows[0], &_fractionS[0], &_fractionT[0]);
+    filterLuminance(&_luminance[0], _width, _height, &_columns[0], &_rows[0],
+                    &_fractionS[0], &_fractionT[0], n, &out.z[0], &out.nx[0],
+                    &out.ny[0]);
+    displace(&in.x[0], &in.y[0], &in.z[0], &in.s[0], &in.t[0], n,
+             _heightScale, texelWidthS, texelWidthT, &out.x[0], &out.y[0],
+             &out.z[0], &out.nx[0], &out.ny[0], &out.nz[0], &out.s[0],
+             &out.t[0]);
+}
+
+void HeightField::warpReference(const Vertices& in, float texelWidthS,
+                                float texelWidthT, Vertices& out) const
+{
+    const size_t n = in.size();
+    out.resize(n);
+    if (!_data)
+        return;
+
+    for (size_t k = 0; k < n; ++k)
+    {
+        float s = in.s[k];
+        float t = in.t[k];
+        float rgba[4];
+
+        sampleRGBA(_data, _width, _height, s, t, 0, 0, rgba);
+        float h = luminance(rgba);
+        sampleRGBA(_data, _width, _height, s, t, 1, 0, rgba);
+        float hdx = luminance(rgba);
+        sampleRGBA(_data, _width, _height, s, t, 0, 1, rgba);
+        float hdy = luminance(rgba);
+
+        float w = edgeWeight(s, t) * _heightScale;
+        h *= w;
+        hdx *= w;
+        hdy *= w;
+
+        out.x[k] = in.x[k];
+        out.y[k] = in.y[k];
+        out.z[k] = in.z[k] + h;
+        out.s[k] = s;
+        out.t[k] = t;
+
+        float ax = texelWidthS, ay = 0, az = hdx - h;
+        float bx = 0, by = texelWidthT, bz = hdy - h;
+        float nx = ay * bz - az * by;
+        float ny = az * bx - ax * bz;
+        float nz = ax * by - ay * bx;
+        float length = sqrtf(nx * nx + ny * ny + nz * nz);
+        out.nx[k] = nx / length;
+        out.ny[k] = ny / length;
+        out.nz[k] = nz / length;
+    }
+}
+
+HeightField::Difference HeightField::compare(const Vertices& a,
+                                             const Vertices& b)
+{
+    Difference d;
+    d.positionMax = 0;
+    d.normalDegreesMax = 0;
+    if (a.size() != b.size())
+    {
+        d.positionMax = d.normalDegreesMax = HUGE_VALF;
+        return d;
+    }
+
+    // For small angles, the arc tangent of the cross product's length over
+    // the dot product is more accurate than the arc cosine of the dot
+    // product.
+
+    double angleMax = 0;
+    for (size_t k = 0; k < a.size(); ++k)
+    {
+        d.positionMax = std::max(d.positionMax, fabsf(a.x[k] - b.x[k]));
+        d.positionMax = std::max(d.positionMax, fabsf(a.y[k] - b.y[k]));
+        d.positionMax = std::max(d.positionMax, fabsf(a.z[k] - b.z[k]));
+
+        double ax = a.nx[k], ay = a.ny[k], az = a.nz[k];
+        double bx = b.nx[k], by = b.ny[k], bz = b.nz[k];
+        double cx = ay * bz - az * by;
+        double cy = az * bx - ax * bz;
+        double cz = ax * by - ay * bx;
+        double dot = ax * bx + ay * by + az * bz;
+        angleMax = std::max(angleMax, atan2(sqrt(cx * cx + cy * cy + cz * cz), dot));
+    }
+
+    const double degreesPerRadian = 180 / M_PI;
+    d.normalDegreesMax = float(angleMax * degreesPerRadian);
+    return d;
+}
+
+void HeightField::makeHeightMap(const uint8_t* data, int width, int height,
+                                int rowLength, std::vector<float>& map,
+                                bool bgra, bool topRowFirst)
+{
+    map.resize(size_t(width) * height * 3);
+    const float scale = 1 / 255.0f;
+    const int r = bgra ? 2 : 0;
+    const int b = 2 - r;
+    for (int j = 0; j < height; ++j)
+    {
+        // The map always has the bottom row first.
+
+        int jRow = topRowFirst ? height - 1 - j : j;
+        int jAbove = std::min(j + 1, height - 1);
+        if (topRowFirst)
+            jAbove = height - 1 - jAbove;
+
+        const uint8_t* row = data + size_t(jRow) * rowLength * bytesPerPixel;
+        const uint8_t* above = data + size_t(jAbove) * rowLength * bytesPerPixel;
+        float* m = &map[size_t(j) * width * 3];
+        for (int i = 0; i < width; ++i, m += 3)
+        {
+            const uint8_t* p = row + i * bytesPerPixel;
+            const uint8_t* right = row + std::min(i + 1, width - 1) * bytesPerPixel;
+            const uint8_t* up = above + i * bytesPerPixel;
+            m[0] = (lumR * p[r] + lumG * p[1] + lumB * p[b]) * scale;
+            m[1] = (lumR * right[r] + lumG * right[1] + lumB * right[b]) * scale;
+            m[2] = (lumR * up[r] + lumG * up[1] + lumB * up[b]) * scale;
+        }
+    }
+}
@@ -0,0 +1,149 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// FacetiousHeightField.h
+//
+// HeightField: A CPU implementation of the warp that
+// LuminanceHeightFieldVertexShader applies to a grid surface.  Each vertex
+// is raised by the luminance of the face texture at its texture
+// coordinates, scaled by a weight that falls to zero near the edges of the
+// surface, and its normal is computed from the heights at the adjacent
+// texels.  It needs no OpenGL, so the warp can be benchmarked and checked
+// on any platform, and used for offline rendering.
+//
+// There are two versions of the computation.  warpReference() is a direct
+// transcription of the shader, sampling the RGBA texture three times per
+// vertex, with bilinear filtering and clamping to the edge as the GPU
+// does.  warp() computes the same result faster: it converts the texture
+// to luminance once, in setTexture(), and its loop over the vertices has
+// no branches and works on separate arrays of each coordinate, so the
+// compiler can vectorize it.  compare() measures how far two results
+// differ.
+//
+// makeHeightMap() precomputes, for each texel, the unweighted heights that
+// the shader needs at a vertex, so a texture made from the map can replace
+// the shader's three samples of the RGBA texture with one.
+//
+
+#ifndef __FacetiousHeightField__
+#define __FacetiousHeightField__
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+class HeightField
+{
+public:
+
+    // Vertices as separate arrays of each coordinate.  The normals are in
+    // the surface's model coordinates, before the shader's normal matrix.
+
+    struct Vertices
+    {
+        void                resize(size_t n);
+        size_t              size() const;
+
+        std::vector<float>  x;
+        std::vector<float>  y;
+        std::vector<float>  z;
+        std::vector<float>  nx;
+        std::vector<float>  ny;
+        std::vector<float>  nz;
+        std::vector<float>  s;
+        std::vector<float>  t;
+    };
+
+    // Fill "grid" with a flat grid of "resX" by "resY" vertices, spanning
+    // -1 to 1 in x and y with texture coordinates spanning 0 to 1, and
+    // normals pointing along z.
+
+    static void         makeGrid(int resX, int resY, Vertices& grid);
+
+    HeightField();
+
+    // Set and get the scale factor for the height, as with
+    // LuminanceHeightFieldVertexShader::setHeightScale().
+
+    void                setHeightScale(float);
+    float               heightScale() const;
+
+    // Set the texture to "width" by "height" RGBA pixels, with the bottom
+    // row first, as uploaded to OpenGL.  The data is used by
+    // warpReference(), so it must remain valid until the next call.
+
+    void                setTexture(const uint8_t* data, int width, int height);
+
+    // Warp the vertices of "in" into "out", which must be a different
+    // object.  The width and height of a texel in surface units are as for
+    // the shader's "texelWidthS" and "texelWidthT" uniforms.
+
+    void                warp(const Vertices& in, float texelWidthS,
+                             float texelWidthT, Vertices& out) const;
+    void                warpReference(const Vertices& in, float texelWidthS,
+                                      float texelWidthT, Vertices& out) const;
+
+    // The largest difference between the positions of corresponding
+    // vertices of "a" and "b", and the largest angle between their normals
+    // in degrees.
+
+    struct Difference
+    {
+        float               positionMax;
+        float               normalDegreesMax;
+    };
+
+    static Difference   compare(const Vertices& a, const Vertices& b);
+
+    // Fill "map" with three floats for each of the "width" by "height"
+    // pixels of the RGBA image "data", whose rows are "rowLength" pixels
+    // long: the luminance of the pixel, of the pixel to its right, and of
+    // the pixel above it, clamped at the edges.  Filtering the map
+    // bilinearly gives the luminance at a position and one texel over in s
+    // and in t, as filtering the image three times would, except within
+    // half a texel of the edges, where the edge weight is zero anyway.
+    // The image may instead be BGRA, and may have its top row first; the
+    // map always has the bottom row first.
+
+    static void         makeHeightMap(const uint8_t* data, int width,
+                                      int height, int rowLength,
+                                      std::vector<float>& map,
+                                      bool bgra = false,
+                                      bool topRowFirst = false);
+
+private:
+    float               _heightScale;
+    const uint8_t*      _data;
+    int                 _width;
+    int                 _height;
+    std::vector<float>  _luminance;
+
+    // Scratch space for warp(), kept between calls to avoid reallocation.
+
+    mutable std::vector<int>   _columns;
+    mutable std::vector<int>   _rows;
+    mutable std::vector<float> _fractionS;
+    mutable std::vector<float> _fractionT;
+};
+
+#endif
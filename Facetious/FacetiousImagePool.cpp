@@ -0,0 +1,171 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+//  FacetiousImagePool.cpp
+//
+
+#include "FacetiousImagePool.h"
+
+#include <assert.h>
+
+FixedImagePool::Handle::Handle() :
+    _pool(0), _index(0)
+{
+}
+
+FixedImagePool::Handle::Handle(FixedImagePool* pool, size_t index) :
+    _pool(pool), _index(index)
+{
+}
+
+FixedImagePool::Handle::Handle(Handle&& other) :
+    _pool(other._pool), _index(other._index)
+{
+    other._pool = 0;
+}
+
+FixedImagePool::Handle& FixedImagePool::Handle::operator=(Handle&& other)
+{
+    if (this != &other)
+    {
+        reset();
+        _pool = other._pool;
+        _index = other._index;
+        other._pool = 0;
+    }
+    return *this;
+}
+
+FixedImagePool::Handle::~Handle()
+{
+    reset();
+}
+
+uint8_t* FixedImagePool::Handle::data() const
+{
+    return _pool ? _pool->_slabs + _index * _pool->_slabStride : 0;
+}
+
+size_t FixedImagePool::Handle::size() const
+{
+    return _pool ? _pool->_slabBytes : 0;
+}
+
+FixedImagePool::Handle::operator bool() const
+{
+    return _pool != 0;
+}
+
+void FixedImagePool::Handle::reset()
+{
+    if (_pool)
+    {
+        _pool->free(_index);
+        _pool = 0;
+    }
+}
+
+//
+
+FixedImagePool::FixedImagePool(size_t slabBytes, size_t slabCount) :
+    _slabBytes(slabBytes),
+    _slabStride((slabBytes + alignment - 1) / alignment * alignment),
+    _slabCount(slabCount), _storage(0), _slabs(0), _highWaterMark(0),
+    _allocations(0), _allocationFailures(0)
+{
+    // Over-allocate so the first slab, and thus every slab, can start on
+    // an aligned address.
+
+    _storage = new uint8_t [_slabStride * _slabCount + alignment];
+    uintptr_t p = reinterpret_cast<uintptr_t>(_storage);
+    _slabs = _storage + (alignment - p % alignment) % alignment;
+
+    _free.reserve(_slabCount);
+    for (size_t i = _slabCount; i > 0; --i)
+        _free.push_back(i - 1);
+}
+
+FixedImagePool::~FixedImagePool()
+{
+    assert(_free.size() == _slabCount);
+    delete [] _storage;
+}
+
+FixedImagePool::Handle FixedImagePool::alloc()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_free.empty())
+    {
+        ++_allocationFailures;
+        return Handle();
+    }
+
+    size_t index = _free.back();
+    _free.pop_back();
+    ++_allocations;
+
+    size_t used = _slabCount - _free.size();
+    if (used > _highWaterMark)
+        _highWaterMark = used;
+
+    return Handle(this, index);
+}
+
+void FixedImagePool::free(size_t index)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    assert(_free.size() < _slabCount);
+    _free.push_back(index);
+}
+
+size_t FixedImagePool::slabBytes() const
+{
+    return _slabBytes;
+}
+
+size_t FixedImagePool::slabCount() const
+{
+    return _slabCount;
+}
+
+size_t FixedImagePool::inUse() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _slabCount - _free.size();
+}
+
+size_t FixedImagePool::highWaterMark() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _highWaterMark;
+}
+
+uint64_t FixedImagePool::allocations() const
+{
+    return _allocations;
+}
+
+uint64_t FixedImagePool::allocationFailures() const
+{
+    return _allocationFailures;
+}
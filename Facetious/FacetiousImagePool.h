@@ -0,0 +1,129 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// FacetiousImagePool.h
+//
+// FixedImagePool: A pool of image buffers ("slabs") that are all allocated
+// when the pool is constructed, each aligned to 64 bytes (a cache line,
+// and enough for any SIMD loads).  The pool never allocates afterwards:
+// when all the slabs are in use, alloc() fails and counts the failure.
+//
+// FixedImagePool::Handle: The owner of a slab taken from the pool.  Like
+// std::unique_ptr, it can be moved but not copied, and it returns the slab
+// to the pool when it is destroyed, so a slab can never be freed with the
+// wrong deallocator or returned twice.
+//
+
+#ifndef __FacetiousImagePool__
+#define __FacetiousImagePool__
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+class FixedImagePool
+{
+public:
+
+    static const size_t alignment = 64;
+
+    class Handle
+    {
+    public:
+        Handle();
+        Handle(Handle&& other);
+        Handle& operator=(Handle&& other);
+        ~Handle();
+
+        // The slab's memory, or null for an empty handle.
+
+        uint8_t*        data() const;
+        size_t          size() const;
+        explicit operator bool() const;
+
+        // Return the slab to the pool now, leaving the handle empty.
+
+        void            reset();
+
+    private:
+        friend class FixedImagePool;
+        Handle(FixedImagePool* pool, size_t index);
+
+        Handle(const Handle&);
+        Handle& operator=(const Handle&);
+
+        FixedImagePool* _pool;
+        size_t          _index;
+    };
+
+    // Allocate "slabCount" slabs of at least "slabBytes" bytes each.
+
+    FixedImagePool(size_t slabBytes, size_t slabCount);
+
+    // All handles must have been destroyed first.
+
+    ~FixedImagePool();
+
+    // Take a free slab.  Returns an empty handle, and counts a failure, if
+    // all slabs are in use.  May be called from any thread, as may the
+    // destruction of the handle.
+
+    Handle              alloc();
+
+    size_t              slabBytes() const;
+    size_t              slabCount() const;
+
+    // Statistics: the number of slabs in use now, the most ever in use at
+    // once, and the numbers of successful and failed calls to alloc().
+
+    size_t              inUse() const;
+    size_t              highWaterMark() const;
+    uint64_t            allocations() const;
+    uint64_t            allocationFailures() const;
+
+private:
+    void                free(size_t index);
+
+    FixedImagePool(const FixedImagePool&);
+    FixedImagePool& operator=(const FixedImagePool&);
+
+    size_t              _slabBytes;
+    size_t              _slabStride;
+    size_t              _slabCount;
+    uint8_t*            _storage;
+    uint8_t*            _slabs;
+
+    // The indices of the free slabs.  The vector's capacity is reserved for
+    // all the slabs, so pushing and popping never allocate.
+
+    mutable std::mutex  _mutex;
+    std::vector<size_t> _free;
+
+    size_t              _highWaterMark;
+    std::atomic<uint64_t> _allocations;
+    std::atomic<uint64_t> _allocationFailures;
+};
+
+#endif
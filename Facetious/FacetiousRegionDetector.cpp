@@ -0,0 +1,172 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+//  FacetiousRegionDetector.cpp
+//
+
+#include "FacetiousRegionDetector.h"
+
+#include <algorithm>
+#include <string.h>
+
+namespace
+{
+    const int bytesPerPixel = 4;
+}
+
+RegionDetector::RegionDetector(FramePipeline::Detector* detector,
+                               int detectionWidthMax, float margin) :
+    _detector(detector), _detectionWidthMax(std::max(1, detectionWidthMax)),
+    _margin(std::max(0.0f, margin)), _hasFace(false),
+    _detectionData(new std::vector<uint8_t>)
+{
+}
+
+void RegionDetector::detect(const FramePipeline::Frame& frame,
+                            std::vector<FramePipeline::Rect>& faces)
+{
+    const int width = frame.width();
+    const int height = frame.height();
+    const size_t facesBefore = faces.size();
+
+    // Search around the previous face first.  If the region is most of the
+    // frame anyway, or the face is not there, search the whole frame.
+
+    bool searchedAll = true;
+    if (_hasFace)
+    {
+        int mx = int(_face.width * _margin);
+        int my = int(_face.height * _margin);
+        FramePipeline::Rect region;
+        region.x = std::max(0, _face.x - mx);
+        region.y = std::max(0, _face.y - my);
+        region.width = std::min(width, _face.x + _face.width + mx) - region.x;
+        region.height = std::min(height, _face.y + _face.height + my) - region.y;
+
+        if ((region.width > 0) && (region.height > 0) &&
+            (2 * region.width * region.height < width * height))
+        {
+            detectInRegion(frame, region, faces);
+            searchedAll = false;
+        }
+    }
+
+    if (searchedAll || (faces.size() == facesBefore))
+        detectInRegion(frame, FramePipeline::Rect(0, 0, width, height), faces);
+
+    // Remember the largest face for the next frame.
+
+    _hasFace = false;
+    for (size_t i = facesBefore; i < faces.size(); ++i)
+    {
+        if (!_hasFace || (std::max(faces[i].width, faces[i].height) >
+                          std::max(_face.width, _face.height)))
+            _face = faces[i];
+        _hasFace = true;
+    }
+}
+
+void RegionDetector::detectInRegion(const FramePipeline::Frame& frame,
+                                    const FramePipeline::Rect& region,
+                                    std::vector<FramePipeline::Rect>& faces)
+{
+    int detectionWidth = std::min(region.width, _detectionWidthMax);
+    int detectionHeight =
+        std::max(1, int(int64_t(region.height) * detectionWidth / region.width));
+
+    std::vector<uint8_t>& detectionData = *_detectionData;
+    const size_t rowBytes = size_t(detectionWidth) * bytesPerPixel;
+    detectionData.resize(rowBytes * detectionHeight);
+
+    FramePipeline::Pixels src;
+    if (frame.getPixels(src) && src.topRowFirst)
+    {
+        // The frame's pixels are in memory with the top row first, as a
+        // RawFrame expects, so the region can be reduced (or copied) from
+        // them straight into the buffer shared with the frame, in their own
+        // format, with no conversion and no flip.
+
+        const int y = frame.height() - (region.y + region.height);
+        if (detectionWidth < region.width)
+        {
+            _downsampler.downsample(&detectionData[0], detectionWidth,
+                                    detectionHeight, src.data, src.rowLength,
+                                    region.x, y, region.width, region.height);
+        }
+        else
+        {
+            for (int j = 0; j < detectionHeight; ++j)
+                memcpy(&detectionData[j * rowBytes], src.data +
+                       (size_t(y + j) * src.rowLength + region.x) * bytesPerPixel,
+                       rowBytes);
+        }
+    }
+    else
+    {
+        _regionData.resize(size_t(region.width) * region.height * bytesPerPixel);
+        frame.getTextureData(region, &_regionData[0]);
+
+        // Reduce the region to the maximum width, keeping its aspect ratio.
+
+        const uint8_t* reduced = &_regionData[0];
+        if (detectionWidth < region.width)
+        {
+            _reducedData.resize(size_t(detectionWidth) * detectionHeight * bytesPerPixel);
+            _downsampler.downsample(&_reducedData[0], detectionWidth,
+                                    detectionHeight, &_regionData[0],
+                                    region.width, 0, 0, region.width,
+                                    region.height);
+            reduced = &_reducedData[0];
+        }
+
+        // The converted data has the bottom row first, and a RawFrame
+        // expects the top row first, so flip the rows while copying them
+        // into the buffer shared with the frame.
+
+        for (int j = 0; j < detectionHeight; ++j)
+            memcpy(&detectionData[(detectionHeight - 1 - j) * rowBytes],
+                   reduced + j * rowBytes, rowBytes);
+
+        src.format = FramePipeline::RGBA;
+    }
+
+    std::shared_ptr<const uint8_t> pixels(_detectionData, &detectionData[0]);
+    FramePipeline::RawFrame detectionFrame(pixels, detectionWidth,
+                                           detectionHeight, src.format);
+
+    _regionFaces.clear();
+    _detector->detect(detectionFrame, _regionFaces);
+
+    // Map the faces back to the full frame.
+
+    const float scaleX = float(region.width) / detectionWidth;
+    const float scaleY = float(region.height) / detectionHeight;
+    for (size_t i = 0; i < _regionFaces.size(); ++i)
+    {
+        const FramePipeline::Rect& f = _regionFaces[i];
+        faces.push_back(FramePipeline::Rect(region.x + int(f.x * scaleX),
+                                            region.y + int(f.y * scaleY),
+                                            int(f.width * scaleX),
+                                            int(f.height * scaleY)));
+    }
+}
@@ -0,0 +1,91 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// FacetiousRegionDetector.h
+//
+// RegionDetector: A front end for another FramePipeline::Detector that
+// hands it a smaller frame than the one captured.  Once a face has been
+// found, only a region of interest around that face is searched in the
+// next frame, and the region (or the whole frame, if there is no face yet
+// or the face has been lost) is reduced to a maximum width first.  The
+// faces found are mapped back to the coordinates of the full frame.  So
+// the cost of detection depends on the size of the face, not the size of
+// the camera's sensor.
+//
+
+#ifndef __FacetiousRegionDetector__
+#define __FacetiousRegionDetector__
+
+#include "FacetiousFramePipeline.h"
+#include "FacetiousDownsample.h"
+
+#include <memory>
+#include <vector>
+#include <stdint.h>
+
+class RegionDetector : public FramePipeline::Detector
+{
+public:
+
+    // Takes ownership of "detector".  The region of interest extends
+    // "margin" times the previous face's size beyond it on each side, and
+    // the frame handed to "detector" is at most "detectionWidthMax" pixels
+    // wide.
+
+    RegionDetector(FramePipeline::Detector* detector,
+                   int detectionWidthMax = 480, float margin = 1.0f);
+
+    virtual void        detect(const FramePipeline::Frame& frame,
+                               std::vector<FramePipeline::Rect>& faces);
+
+private:
+
+    // Run the detector on "region" of "frame", adding the faces found to
+    // "faces" in the frame's coordinates.
+
+    void                detectInRegion(const FramePipeline::Frame& frame,
+                                       const FramePipeline::Rect& region,
+                                       std::vector<FramePipeline::Rect>& faces);
+
+    std::unique_ptr<FramePipeline::Detector> _detector;
+    int                 _detectionWidthMax;
+    float               _margin;
+
+    // The largest face found in the previous frame, if any.
+
+    bool                _hasFace;
+    FramePipeline::Rect _face;
+
+    // Scratch space, kept between calls to avoid reallocation.  The
+    // reduced region is shared with the FramePipeline::RawFrame handed to
+    // the detector.  The converted region is needed only for frames whose
+    // pixels cannot be read directly.
+
+    std::vector<uint8_t> _regionData;
+    std::vector<uint8_t> _reducedData;
+    std::shared_ptr<std::vector<uint8_t> > _detectionData;
+    std::vector<FramePipeline::Rect> _regionFaces;
+    Downsampler         _downsampler;
+};
+
+#endif
@@ -0,0 +1,427 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+//  FacetiousRegression.cpp
+//
+
+#include "FacetiousRegression.h"
+#include "FacetiousCppNSOpenGL.h"
+#include "FacetiousFramebuffer.h"
+
+#include <OpenGL/OpenGL.h>
+#include <OpenGL/gl3.h>
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+#include <stdlib.h>
+
+namespace
+{
+    // The rotations, in degrees, at which frames are compared: the front,
+    // turned to each side, tilted, and turned far enough to show the back
+    // surface's edge.
+
+    struct Pose
+    {
+        float           angleX;
+        float           angleY;
+    };
+
+    const Pose poses[] =
+    {
+        {   0.0f,   0.0f },
+        {   0.0f,  35.0f },
+        {   0.0f, -35.0f },
+        {  35.0f,   0.0f },
+        { -25.0f,  20.0f },
+        {  50.0f,  50.0f }
+    };
+
+    const int frameWidth = 512;
+    const int frameHeight = 512;
+
+    // A pixel differs if any of its channels differs by more than
+    // "channelTolerance", and a frame matches if at most "pixelFractionMax"
+    // of its pixels differ.  The tolerances allow for the small variations
+    // of the face from the detector and the stabilization, not for changes
+    // a viewer would notice.
+
+    const int channelTolerance = 16;
+    const double pixelFractionMax = 0.005;
+
+    // The face images to wait for from a source before comparing frames,
+    // enough for the stabilization of the face to settle, and the longest
+    // to wait for them.
+
+    const uint64_t settleFaceImages = 30;
+    const std::chrono::seconds settleTimeMax(20);
+
+    // The frames drawn at each pose to time the rendering.
+
+    const int timedFrames = 20;
+
+    // The step of the animation per frame, in seconds, and the frames of
+    // the animation to compare, turning left, turning right and tilting.
+
+    const double animationStep = 1 / 30.0;
+    const int animationFrames[] = { 60, 240, 750 };
+
+    typedef std::chrono::steady_clock Clock;
+
+    // An RGB image with the top row first, as in a binary PPM file.
+
+    struct Image
+    {
+        Image() : width(0), height(0) {}
+        int             width;
+        int             height;
+        std::vector<uint8_t> rgb;
+    };
+
+    bool readPpm(const std::string& path, Image& image)
+    {
+        std::ifstream in(path.c_str(), std::ios::binary);
+        std::string magic;
+        int maxValue = 0;
+        in >> magic >> image.width >> image.height >> maxValue;
+        in.get();
+        if (!in || (magic != "P6") || (maxValue != 255) ||
+            (image.width <= 0) || (image.height <= 0))
+            return false;
+        image.rgb.resize(size_t(image.width) * image.height * 3);
+        in.read(reinterpret_cast<char*>(&image.rgb[0]), image.rgb.size());
+        return bool(in);
+    }
+
+    bool writePpm(const std::string& path, const Image& image)
+    {
+        std::ofstream out(path.c_str(), std::ios::binary);
+        out << "P6\n" << image.width << " " << image.height << "\n255\n";
+        out.write(reinterpret_cast<const char*>(&image.rgb[0]), image.rgb.size());
+        return bool(out);
+    }
+
+    // Read the framebuffer's RGBA pixels, with the bottom row first, into
+    // an Image.
+
+    void readFrame(Framebuffer& framebuffer, Image& image)
+    {
+        const int w = framebuffer.width();
+        const int h = framebuffer.height();
+        std::vector<GLubyte> rgba(size_t(w) * h * 4);
+        framebuffer.readPixels(&rgba[0]);
+
+        image.width = w;
+        image.height = h;
+        image.rgb.resize(size_t(w) * h * 3);
+        for (int j = 0; j < h; ++j)
+        {
+            const GLubyte* src = &rgba[size_t(h - 1 - j) * w * 4];
+            uint8_t* dst = &image.rgb[size_t(j) * w * 3];
+            for (int i = 0; i < w; ++i, src += 4, dst += 3)
+            {
+                dst[0] = src[0];
+                dst[1] = src[1];
+                dst[2] = src[2];
+            }
+        }
+    }
+
+    struct Difference
+    {
+        int             channelMax;
+        double          channelMean;
+        double          pixelFraction;
+    };
+
+    // Compare two images of the same size, setting "diff" to an image of
+    // the differing pixels, in red over a dimmed copy of "expected".
+
+    Difference compare(const Image& expected, const Image& actual, Image& diff)
+    {
+        Difference d = { 0, 0.0, 0.0 };
+        diff = expected;
+        size_t pixels = size_t(expected.width) * expected.height;
+        size_t differing = 0;
+        double sum = 0;
+        for (size_t k = 0; k < pixels; ++k)
+        {
+            int pixelMax = 0;
+            for (int c = 0; c < 3; ++c)
+            {
+                int delta = abs(int(expected.rgb[k * 3 + c]) - int(actual.rgb[k * 3 + c]));
+                pixelMax = std::max(pixelMax, delta);
+                sum += delta;
+            }
+            d.channelMax = std::max(d.channelMax, pixelMax);
+            uint8_t* p = &diff.rgb[k * 3];
+            if (pixelMax > channelTolerance)
+            {
+                ++differing;
+                p[0] = 255;
+                p[1] = p[2] = 0;
+            }
+            else
+            {
+                p[0] /= 4;
+                p[1] /= 4;
+                p[2] /= 4;
+            }
+        }
+        d.channelMean = sum / (pixels * 3);
+        d.pixelFraction = double(differing) / pixels;
+        return d;
+    }
+
+    // An offscreen core profile context on the software renderer, whose
+    // output does not depend on the GPU or its driver.
+
+    class SoftwareContext
+    {
+    public:
+        SoftwareContext() : _context(0)
+        {
+            CGLPixelFormatAttribute attributes[] =
+            {
+                kCGLPFAOpenGLProfile, CGLPixelFormatAttribute(kCGLOGLPVersion_3_2_Core),
+                kCGLPFARendererID, CGLPixelFormatAttribute(kCGLRendererGenericFloatID),
+                kCGLPFAColorSize, CGLPixelFormatAttribute(24),
+                kCGLPFAAlphaSize, CGLPixelFormatAttribute(8),
+                kCGLPFADepthSize, CGLPixelFormatAttribute(24),
+                CGLPixelFormatAttribute(0)
+            };
+            CGLPixelFormatObj pixelFormat = 0;
+            GLint count = 0;
+            if ((CGLChoosePixelFormat(attributes, &pixelFormat, &count) != kCGLNoError) ||
+                !pixelFormat)
+                throw std::runtime_error("No pixel format for the software renderer");
+            CGLError error = CGLCreateContext(pixelFormat, 0, &_context);
+            CGLDestroyPixelFormat(pixelFormat);
+            if (error != kCGLNoError)
+                throw std::runtime_error("Cannot create a context on the software renderer");
+            CGLSetCurrentContext(_context);
+        }
+
+        ~SoftwareContext()
+        {
+            CGLSetCurrentContext(0);
+            CGLDestroyContext(_context);
+        }
+
+    private:
+        SoftwareContext(const SoftwareContext&);
+        SoftwareContext& operator=(const SoftwareContext&);
+
+        CGLContextObj   _context;
+    };
+
+    // Draw one frame into "target", which draw() treats as the window's
+    // framebuffer, and wait for it to finish.
+
+    void drawFrame(FacetiousCppNSOpenGL& app, Framebuffer& target)
+    {
+        target.bind();
+        app.draw();
+        glFinish();
+    }
+
+    // Compare the frame in "target" with the golden image at "name".ppm,
+    // finishing the line of output about the frame, and return whether it
+    // matches.  A missing golden image fails, unless "record" is true, in
+    // which case the frame is written as the golden image.  The actual
+    // frame and the differences are written next to a golden image that
+    // does not match.
+
+    bool check(Framebuffer& target, const std::string& name, bool record)
+    {
+        Image actual;
+        readFrame(target, actual);
+
+        std::string goldenPath = name + ".ppm";
+        Image golden;
+        if (!readPpm(goldenPath, golden))
+        {
+            if (!record)
+            {
+                std::cout << ", cannot read " << goldenPath << "  FAILED\n";
+                return false;
+            }
+            if (!writePpm(goldenPath, actual))
+            {
+                std::cout << ", cannot write " << goldenPath << "\n";
+                return false;
+            }
+            std::cout << ", wrote " << goldenPath << "\n";
+            return true;
+        }
+        if ((golden.width != actual.width) || (golden.height != actual.height))
+        {
+            std::cout << ", golden image is " << golden.width << "x"
+                      << golden.height << "  FAILED\n";
+            return false;
+        }
+
+        Image diff;
+        Difference d = compare(golden, actual, diff);
+        bool match = (d.pixelFraction <= pixelFractionMax);
+        std::cout << ", max difference " << d.channelMax << ", mean "
+                  << std::fixed << std::setprecision(2) << d.channelMean
+                  << ", " << std::setprecision(3) << 100 * d.pixelFraction
+                  << "% of pixels differ" << (match ? "" : "  FAILED") << "\n";
+        if (!match)
+        {
+            writePpm(name + "-actual.ppm", actual);
+            writePpm(name + "-diff.ppm", diff);
+        }
+        return match;
+    }
+
+    double milliseconds(Clock::duration d)
+    {
+        return std::chrono::duration<double, std::milli>(d).count();
+    }
+
+    bool run(const std::string& goldenDir)
+    {
+        SoftwareContext context;
+
+        // Render every frame, so each draw() can be timed.  Without a
+        // source given, use the default face image rather than the camera.
+
+        setenv("FACETIOUS_RENDER_ON_DEMAND", "0", 1);
+        setenv("FACETIOUS_SOURCE", "none", 0);
+        bool fromSource = (std::string(getenv("FACETIOUS_SOURCE")) != "none");
+
+        // Missing golden images are written only when asked for, so a run
+        // against the wrong directory fails rather than recording.
+
+        const char* recordValue = getenv("FACETIOUS_REGRESSION_RECORD");
+        bool record = recordValue && (std::string(recordValue) != "0");
+
+        FacetiousCppNSOpenGL app(0);
+        app.init();
+        app.reshape(frameWidth, frameHeight);
+
+        Framebuffer target;
+        target.resize(frameWidth, frameHeight);
+
+        // Let the detector find the face in enough frames from the source
+        // for its stabilized position to settle.
+
+        if (fromSource)
+        {
+            Clock::time_point end = Clock::now() + settleTimeMax;
+            app.setRotation(0, 0);
+            while (app.faceImagesReceived() < settleFaceImages)
+            {
+                if (Clock::now() > end)
+                {
+                    std::cerr << "Only " << app.faceImagesReceived()
+                              << " face images were received from the source\n";
+                    return false;
+                }
+                drawFrame(app, target);
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+
+            // Then stop the source and the detection, so the face does not
+            // change while frames are compared.
+
+            app.freezeFace();
+        }
+
+        bool ok = true;
+        double totalMs = 0;
+        const int poseCount = int(sizeof(poses) / sizeof(poses[0]));
+        for (int i = 0; i < poseCount; ++i)
+        {
+            app.setRotation(poses[i].angleX, poses[i].angleY);
+
+            Clock::time_point start = Clock::now();
+            for (int k = 0; k < timedFrames; ++k)
+                drawFrame(app, target);
+            double ms = milliseconds(Clock::now() - start) / timedFrames;
+            totalMs += ms;
+
+            std::cout << "pose " << i << " (" << poses[i].angleX << ", "
+                      << poses[i].angleY << "): " << std::fixed
+                      << std::setprecision(2) << ms << " ms/frame";
+
+            std::ostringstream name;
+            name << goldenDir << "/pose" << i;
+            ok = check(target, name.str(), record) && ok;
+        }
+        std::cout << "mean " << std::fixed << std::setprecision(2)
+                  << totalMs / poseCount << " ms/frame\n";
+
+        // Then run the animation from its start with a fixed step per
+        // frame, as fast as the frames render, and compare frames along it.
+
+        app.setAnimationStep(0, animationStep);
+        int frame = 0;
+        Clock::time_point start = Clock::now();
+        const int checkCount = int(sizeof(animationFrames) / sizeof(animationFrames[0]));
+        for (int i = 0; i < checkCount; ++i)
+        {
+            for (; frame < animationFrames[i]; ++frame)
+                drawFrame(app, target);
+
+            std::cout << "animation frame " << frame << " (" << std::fixed
+                      << std::setprecision(2) << frame * animationStep << " s)";
+
+            std::ostringstream name;
+            name << goldenDir << "/animation" << i;
+            ok = check(target, name.str(), record) && ok;
+        }
+        std::cout << "animation " << frame << " frames, " << std::fixed
+                  << std::setprecision(2)
+                  << milliseconds(Clock::now() - start) / frame << " ms/frame\n";
+        return ok;
+    }
+}
+
+// This function must be labeled 'extern "C"' so it can be called as pure C
+// from main.m.
+
+extern "C" int facetiousRegression(const char* goldenDir)
+{
+    try
+    {
+        return run(goldenDir) ? 0 : 1;
+    }
+    catch (const std::exception& exc)
+    {
+        std::cerr << exc.what() << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,50 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// FacetiousRegression.h
+//
+// This header must be pure C, so it can be imported by main.m.
+// facetiousRegression() runs the application's rendering offscreen, in a
+// context on Apple's software renderer, at fixed rotations of the surface
+// and at fixed times in its animation, and compares each frame with a
+// golden image.  It lets changes made for
+// performance be checked for keeping the output the same, without a window
+// or a camera.
+//
+
+#ifndef __FacetiousRegression__
+#define __FacetiousRegression__
+
+// Render the frames and compare them with the golden images in the
+// directory "goldenDir".  A missing golden image fails the comparison,
+// unless the environment variable FACETIOUS_REGRESSION_RECORD is set (to
+// other than 0), in which case it is written instead.  Prints the
+// differences and the wall time per frame, and returns 0 if every frame
+// matches within the tolerance, or 1 otherwise.
+
+#ifdef __cplusplus
+extern "C"
+#endif
+int facetiousRegression(const char* goldenDir);
+
+#endif
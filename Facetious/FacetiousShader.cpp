@@ -29,19 +29,17 @@
 #include "AglSurfacePNT.h"
 #include "AglTextureUbyte.h"
 #include <OpenEXR/ImathMatrixAlgo.h>
+#include <algorithm>
+#include <vector>
 #include <assert.h>
 
     
 class LuminanceHeightFieldVertexShader::Imp
 {
 public:
-    Imp() : defaultTextureWrapS(GL_CLAMP_TO_EDGE),
-        defaultTextureWrapT(GL_CLAMP_TO_EDGE),
-        texelWidthSUniform(-1), texelWidthTUniform(-1),
+    Imp() : texelWidthSUniform(-1), texelWidthTUniform(-1),
         heightScale(1/3.0f), heightScaleUniform(-1) {}
     static const char*  text;
-    GLint               defaultTextureWrapS;
-    GLint               defaultTextureWrapT;
     GLint               texelWidthSUniform;
     GLint               texelWidthTUniform;
     GLfloat             heightScale;
@@ -134,15 +132,6 @@ void LuminanceHeightFieldVertexShader::postLink()
 
 void LuminanceHeightFieldVertexShader::preDraw()
 {
-    // Save the current texture wrapping settings so they can be changed and then
-    // restored after drawing.
-    
-    glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, &_m->defaultTextureWrapS);
-    glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, &_m->defaultTextureWrapT);
-    
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    
     glUniform1f(_m->heightScaleUniform, _m->heightScale);
 }
 
@@ -154,6 +143,14 @@ void LuminanceHeightFieldVertexShader::preDraw(Agl::SurfacePNT* surface)
     {
         texture->bind();
         
+        // The adjacent texels must not wrap around at the edges.  Wrapping
+        // is state of the texture object, so clamping the texture being
+        // drawn needs no query of its previous setting and no restoring
+        // it afterwards, which would stall the pipeline.
+        
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        
         // When the shader computes the normal vector at each warped vertex,
         // it takes the cross product of vectors to nearby locations in the
         // height field.  To efficiently get the heights at those locations,
@@ -175,12 +172,6 @@ void LuminanceHeightFieldVertexShader::preDraw(Agl::SurfacePNT* surface)
     }
 }
 
-void LuminanceHeightFieldVertexShader::postDraw()
-{
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, _m->defaultTextureWrapS);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, _m->defaultTextureWrapT);
-}
-
 const char* LuminanceHeightFieldVertexShader::modelViewProjectionMatrixUniformName() const
 {
     return "modelViewProjMatrix";
@@ -206,4 +197,276 @@ const char* LuminanceHeightFieldVertexShader::texCoordAttributeName() const
     return "in_texCoord";
 }
 
+//
+
+HeightMapTexture::HeightMapTexture() :
+    _id(0), _width(0), _height(0)
+{
+    glGenTextures(1, &_id);
+    glBindTexture(GL_TEXTURE_2D, _id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+HeightMapTexture::~HeightMapTexture()
+{
+    glDeleteTextures(1, &_id);
+}
+
+void HeightMapTexture::setData(const GLfloat* data, GLsizei width,
+                               GLsizei height)
+{
+    // Half floats have plenty of precision for heights from 8-bit colors,
+    // and can be filtered on all hardware.  Reallocate the storage only
+    // when the size changes.
+
+    glBindTexture(GL_TEXTURE_2D, _id);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    if ((width != _width) || (height != _height))
+    {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB,
+                     GL_FLOAT, data);
+        _width = width;
+        _height = height;
+    }
+    else
+    {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGB,
+                        GL_FLOAT, data);
+    }
+}
+
+GLuint HeightMapTexture::id() const
+{
+    return _id;
+}
+
+GLsizei HeightMapTexture::width() const
+{
+    return _width;
+}
+
+GLsizei HeightMapTexture::height() const
+{
+    return _height;
+}
+
+//
+
+class HeightMapVertexShader::Imp
+{
+public:
+    Imp() : heightMap(0), heightMapUniform(-1), texelWidthSUniform(-1),
+        texelWidthTUniform(-1), heightScale(1/3.0f), heightScaleUniform(-1),
+        flipTextureT(false), flipTextureTUniform(-1), displaceUniform(-1) {}
+    static const char*  text;
+    HeightMapTexture*   heightMap;
+    GLint               heightMapUniform;
+    GLint               texelWidthSUniform;
+    GLint               texelWidthTUniform;
+    GLfloat             heightScale;
+    GLint               heightScaleUniform;
+    bool                flipTextureT;
+    GLint               flipTextureTUniform;
+    std::vector<const Agl::SurfacePNT*> flatSurfaces;
+    GLint               displaceUniform;
+};
+
+// The height map is on texture unit 1, leaving unit 0 for the face texture
+// used by the fragment shader.
+
+const GLint heightMapTextureUnit = 1;
+
+const char* HeightMapVertexShader::Imp::text =
+    "#version 150\n"
+    "uniform mat4 modelViewProjMatrix;\n"
+    "uniform mat3 normalMatrix;\n"
+    "// The luminance at each texel, and at the texels to its right and\n"
+    "// above it.\n"
+    "uniform sampler2D heightMap;\n"
+    "// The width and height of a texel in surface units.\n"
+    "uniform float texelWidthS;\n"
+    "uniform float texelWidthT;\n"
+    "// An overall scaling factor for the luminance-based height.\n"
+    "uniform float heightScale;\n"
+    "// Whether the face texture has its top row first, in which case its\n"
+    "// t coordinate is flipped for the fragment shader.\n"
+    "uniform bool flipTextureT;\n"
+    "// Whether to displace the surface by the height map.  If not, the\n"
+    "// surface is drawn with its own normals, like BasicVertexShader.\n"
+    "uniform bool displace;\n"
+    "in vec4 in_position;\n"
+    "in vec2 in_texCoord;\n"
+    "in vec3 in_normal;\n"
+    "out vec2 vs_texCoord;\n"
+    "out vec3 vs_normal;\n"
+    "void main()\n"
+    "{\n"
+    "    if (!displace)\n"
+    "    {\n"
+    "        gl_Position = modelViewProjMatrix * in_position;\n"
+    "        vs_texCoord = in_texCoord;\n"
+    "        vs_normal = normalize(normalMatrix * in_normal);\n"
+    "        return;\n"
+    "    }\n"
+    "    // The height at this vertex and at the adjacent texels, in one fetch.\n"
+    "    vec3 m = texture(heightMap, in_texCoord).rgb;\n"
+    "    // Compute a weight, w, that drops to 0 at the edges of the surface.\n"
+    "    float w = min(in_texCoord.s / 0.1, 1.0);\n"
+    "    w *= min((1.0 - in_texCoord.s) / 0.1, 1.0);\n"
+    "    w *= min(in_texCoord.t / 0.1, 1.0);\n"
+    "    w *= min((1.0 - in_texCoord.t) / 0.1, 1.0);\n"
+    "    // Include an overall scaling for the height.\n"
+    "    m *= w * heightScale;\n"
+    "    vec4 v = in_position;\n"
+    "    v.z += m.x;\n"
+    "    gl_Position = modelViewProjMatrix * v;\n"
+    "    vs_texCoord = in_texCoord;\n"
+    "    if (flipTextureT)\n"
+    "        vs_texCoord.t = 1.0 - in_texCoord.t;\n"
+    "    vec3 n = vec3(-(m.y - m.x) * texelWidthT, -(m.z - m.x) * texelWidthS,\n"
+    "                  texelWidthS * texelWidthT);\n"
+    "    // VertexShaderPNT expects in_normal to be used, even though\n"
+    "    // this shader is unusual in that it does not need it.\n"
+    "    vs_normal = in_normal;\n"
+    "    vs_normal = normalize(normalMatrix * n);\n"
+    "}\n";
+
+HeightMapVertexShader::HeightMapVertexShader() :
+    Agl::VertexShaderPNT(Imp::text), _m(new Imp)
+{
+}
+
+HeightMapVertexShader::~HeightMapVertexShader()
+{
+}
+
+void HeightMapVertexShader::setHeightScale(GLfloat s)
+{
+    _m->heightScale = s;
+}
+
+GLfloat HeightMapVertexShader::heightScale() const
+{
+    return _m->heightScale;
+}
+
+void HeightMapVertexShader::setHeightMap(HeightMapTexture* heightMap)
+{
+    _m->heightMap = heightMap;
+}
+
+void HeightMapVertexShader::setFlipTextureT(bool f)
+{
+    _m->flipTextureT = f;
+}
+
+bool HeightMapVertexShader::flipTextureT() const
+{
+    return _m->flipTextureT;
+}
+
+void HeightMapVertexShader::addFlatSurface(const Agl::SurfacePNT* surface)
+{
+    _m->flatSurfaces.push_back(surface);
+}
+
+void HeightMapVertexShader::postLink()
+{
+    VertexShaderPNT::postLink();
+
+    _m->heightMapUniform = glGetUniformLocation(shaderProgram()->id(), "heightMap");
+    _m->texelWidthTUniform = glGetUniformLocation(shaderProgram()->id(), "texelWidthT");
+    _m->texelWidthSUniform = glGetUniformLocation(shaderProgram()->id(), "texelWidthS");
+    _m->heightScaleUniform = glGetUniformLocation(shaderProgram()->id(), "heightScale");
+    _m->flipTextureTUniform = glGetUniformLocation(shaderProgram()->id(), "flipTextureT");
+    _m->displaceUniform = glGetUniformLocation(shaderProgram()->id(), "displace");
+
+    // Use assertions rather than exceptions here because the shader text
+    // not set by the caller.
+
+    assert (_m->heightMapUniform >= 0);
+    assert (_m->texelWidthSUniform >= 0);
+    assert (_m->texelWidthTUniform >= 0);
+    assert (_m->heightScaleUniform >= 0);
+    assert (_m->flipTextureTUniform >= 0);
+    assert (_m->displaceUniform >= 0);
+}
+
+void HeightMapVertexShader::preDraw()
+{
+    // The height map's own texture object keeps its clamping, so unlike
+    // LuminanceHeightFieldVertexShader, there are no texture parameters to
+    // save and restore.
+
+    if (_m->heightMap)
+    {
+        glActiveTexture(GL_TEXTURE0 + heightMapTextureUnit);
+        glBindTexture(GL_TEXTURE_2D, _m->heightMap->id());
+        glActiveTexture(GL_TEXTURE0);
+    }
 
+    glUniform1i(_m->heightMapUniform, heightMapTextureUnit);
+    glUniform1f(_m->heightScaleUniform, _m->heightScale);
+    glUniform1i(_m->flipTextureTUniform, _m->flipTextureT);
+}
+
+void HeightMapVertexShader::preDraw(Agl::SurfacePNT* surface)
+{
+    Agl::VertexShaderPNT::preDraw(surface);
+
+    // The fragment shader still uses the face texture for color.
+
+    if (Agl::TextureUbyte* texture = surface->texture())
+        texture->bind();
+
+    bool flat = (std::find(_m->flatSurfaces.begin(), _m->flatSurfaces.end(),
+                           surface) != _m->flatSurfaces.end());
+    glUniform1i(_m->displaceUniform, !flat);
+    if (flat)
+        return;
+
+    if (_m->heightMap && (_m->heightMap->width() > 0))
+    {
+        // As in LuminanceHeightFieldVertexShader, approximate the
+        // displacements to the adjacent texels as the width and height of
+        // a texel in surface units.
+
+        Imath::M44f modelMatrix = surface->modelMatrix();
+        Imath::V3f scale;
+        Imath::extractScaling(modelMatrix, scale);
+
+        GLfloat texelWidthS = scale.x / _m->heightMap->width();
+        GLfloat texelWidthT = scale.y / _m->heightMap->height();
+
+        glUniform1f(_m->texelWidthSUniform, texelWidthS);
+        glUniform1f(_m->texelWidthTUniform, texelWidthT);
+    }
+}
+
+const char* HeightMapVertexShader::modelViewProjectionMatrixUniformName() const
+{
+    return "modelViewProjMatrix";
+}
+
+const char* HeightMapVertexShader::normalMatrixUniformName() const
+{
+    return "normalMatrix";
+}
+
+const char* HeightMapVertexShader::positionAttributeName() const
+{
+    return "in_position";
+}
+
+const char* HeightMapVertexShader::normalAttributeName() const
+{
+    return "in_normal";
+}
+
+const char* HeightMapVertexShader::texCoordAttributeName() const
+{
+    return "in_texCoord";
+}
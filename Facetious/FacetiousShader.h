@@ -27,10 +27,20 @@
 // a flat grid surface, giving each vertex a height based on the luminance
 // (perceived brightness) of a texture at the position of the vertex.
 //
+// HeightMapVertexShader: The same warp, but with the luminance at each
+// texel and its neighbors precomputed in a HeightMapTexture (see
+// HeightField::makeHeightMap()), so the shader samples one texture once
+// per vertex rather than three times, and does not recompute luminance.
+// The map changes only when the face texture does, while the shader runs
+// for every vertex of every frame.
+//
+// HeightMapTexture: A floating-point texture holding a height map.
+//
 // LuminancePhongShaderProgram, LuminanceHarmonicsShaderProgram,
+// HeightMapPhongShaderProgram, HeightMapHarmonicsShaderProgram,
 // BasicPhongShaderProgram, BasicHarmonicsShaderProgra: typedefs for
 // instatiations of the Agl::ShaderProgramSpecific template, for
-// the four combinations of vertex and fragment shaders used in the
+// the combinations of vertex and fragment shaders used in the
 // Facetious application.
 
 #ifndef __FacetiousShader__
@@ -80,10 +90,6 @@ public:
     
     virtual void        preDraw(Agl::SurfacePNT*);
     
-    // Clean up after drawing all surfaces with this shader.
-    
-    virtual void        postDraw();
-    
 protected:
     
     // The names in the shader code for the uniform variables for the
@@ -107,6 +113,81 @@ private:
     std::unique_ptr<Imp> _m;
 };
 
+class HeightMapTexture
+{
+public:
+    HeightMapTexture();
+    ~HeightMapTexture();
+
+    // Replace the map with "width" by "height" texels of three floats
+    // each, as made by HeightField::makeHeightMap().
+
+    void                setData(const GLfloat* data, GLsizei width,
+                                GLsizei height);
+
+    GLuint              id() const;
+    GLsizei             width() const;
+    GLsizei             height() const;
+
+private:
+    GLuint              _id;
+    GLsizei             _width;
+    GLsizei             _height;
+};
+
+class HeightMapVertexShader : public Agl::VertexShaderPNT
+{
+public:
+
+    HeightMapVertexShader();
+    virtual ~HeightMapVertexShader();
+
+    // Set and get a scale factor for the height at each vertex (1.0f
+    // leaves the height unscaled).
+
+    void                setHeightScale(GLfloat);
+    GLfloat             heightScale() const;
+
+    // Set the height map.  The shader does not own it.
+
+    void                setHeightMap(HeightMapTexture*);
+
+    // Set and get whether the face texture has its top row first, as when
+    // it comes directly from a camera buffer, so the shader flips its t
+    // coordinate rather than the image being flipped in memory.  The
+    // height map always has the bottom row first.
+
+    void                setFlipTextureT(bool);
+    bool                flipTextureT() const;
+
+    // Draw "surface" without displacing it, with its own normals, as
+    // Agl::BasicVertexShader would.  Then a shader program with this
+    // shader can draw that surface too, like the back surface, in the same
+    // draw() as the face, rather than another program drawing it.
+
+    void                addFlatSurface(const Agl::SurfacePNT*);
+
+    using VertexShaderPNT::postLink;
+
+    virtual void        postLink();
+    virtual void        preDraw();
+    virtual void        preDraw(Agl::SurfacePNT*);
+
+protected:
+    virtual const char* modelViewProjectionMatrixUniformName() const;
+    virtual const char* normalMatrixUniformName() const;
+    virtual const char* positionAttributeName() const;
+    virtual const char* normalAttributeName() const;
+    virtual const char* texCoordAttributeName() const;
+
+private:
+
+    // Details of the class' data are hidden in the .cpp file.
+
+    class Imp;
+    std::unique_ptr<Imp> _m;
+};
+
 
 // Typedefs for specific shader programs instantiated from the template.
 
@@ -120,6 +201,16 @@ typedef Agl::ShaderProgramSpecific<LuminanceHeightFieldVertexShader,
                                    Agl::FlattishRectangularSurface>
     LuminanceHarmonicsShaderProgram;
 
+typedef Agl::ShaderProgramSpecific<HeightMapVertexShader,
+                                   Agl::PhongOneDirectionalFragmentShader,
+                                   Agl::FlattishRectangularSurface>
+    HeightMapPhongShaderProgram;
+
+typedef Agl::ShaderProgramSpecific<HeightMapVertexShader,
+                                   Agl::SphericalHarmonicsFragmentShader,
+                                   Agl::FlattishRectangularSurface>
+    HeightMapHarmonicsShaderProgram;
+
 typedef Agl::ShaderProgramSpecific<Agl::BasicVertexShader,
                                    Agl::PhongOneDirectionalFragmentShader,
                                    Agl::FlattishRectangularSurface>
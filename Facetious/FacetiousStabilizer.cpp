@@ -0,0 +1,215 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+//  FacetiousStabilizer.cpp
+//
+
+#include "FacetiousStabilizer.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    const float pi = 3.14159265f;
+
+    // The four lanes of the stabilizer as one value, in an SSE2 register
+    // when the compiler targets SSE2, and otherwise in an array.
+
+    struct Vec4
+    {
+#if defined(__SSE2__)
+        Vec4(__m128 v) : v(v) {}
+        explicit Vec4(float s) : v(_mm_set1_ps(s)) {}
+        static Vec4 load(const float* p) { return Vec4(_mm_load_ps(p)); }
+        static Vec4 loadu(const float* p) { return Vec4(_mm_loadu_ps(p)); }
+        void store(float* p) const { _mm_store_ps(p, v); }
+        void storeu(float* p) const { _mm_storeu_ps(p, v); }
+        Vec4 operator+(Vec4 b) const { return Vec4(_mm_add_ps(v, b.v)); }
+        Vec4 operator-(Vec4 b) const { return Vec4(_mm_sub_ps(v, b.v)); }
+        Vec4 operator*(Vec4 b) const { return Vec4(_mm_mul_ps(v, b.v)); }
+        Vec4 operator/(Vec4 b) const { return Vec4(_mm_div_ps(v, b.v)); }
+        Vec4 abs() const { return Vec4(_mm_andnot_ps(_mm_set1_ps(-0.0f), v)); }
+        __m128 v;
+#else
+        explicit Vec4(float s) { for (int i = 0; i < 4; ++i) v[i] = s; }
+        static Vec4 load(const float* p) { Vec4 r(0.0f); memcpy(r.v, p, sizeof(r.v)); return r; }
+        static Vec4 loadu(const float* p) { return load(p); }
+        void store(float* p) const { memcpy(p, v, sizeof(v)); }
+        void storeu(float* p) const { store(p); }
+        Vec4 operator+(Vec4 b) const { for (int i = 0; i < 4; ++i) b.v[i] = v[i] + b.v[i]; return b; }
+        Vec4 operator-(Vec4 b) const { for (int i = 0; i < 4; ++i) b.v[i] = v[i] - b.v[i]; return b; }
+        Vec4 operator*(Vec4 b) const { for (int i = 0; i < 4; ++i) b.v[i] = v[i] * b.v[i]; return b; }
+        Vec4 operator/(Vec4 b) const { for (int i = 0; i < 4; ++i) b.v[i] = v[i] / b.v[i]; return b; }
+        Vec4 abs() const { Vec4 r(*this); for (int i = 0; i < 4; ++i) r.v[i] = (v[i] < 0) ? -v[i] : v[i]; return r; }
+        float v[4];
+#endif
+    };
+
+    // The weight of the new sample in an exponential average with cutoff
+    // frequency "cutoff", in hertz, for samples "dt" seconds apart.
+
+    Vec4 oneEuroAlpha(Vec4 cutoff, Vec4 dt)
+    {
+        Vec4 r = Vec4(2.0f * pi) * cutoff * dt;
+        return r / (r + Vec4(1.0f));
+    }
+}
+
+Stabilizer::Settings Stabilizer::parse(const std::string& spec)
+{
+    Settings settings;
+    size_t colon = spec.find(':');
+    std::string kind = spec.substr(0, colon);
+    std::string params = (colon == std::string::npos) ? "" : spec.substr(colon + 1);
+    bool ok = true;
+    if (kind == "average")
+    {
+        settings.filter = MovingAverage;
+        if (!params.empty())
+            ok = (sscanf(params.c_str(), "%d", &settings.window) == 1) &&
+                (settings.window >= 1) && (settings.window <= WindowMax);
+    }
+    else if (kind == "exponential")
+    {
+        settings.filter = ExponentialAverage;
+        if (!params.empty())
+            ok = (sscanf(params.c_str(), "%f", &settings.smoothing) == 1) &&
+                (settings.smoothing > 0) && (settings.smoothing <= 1);
+    }
+    else if (kind == "oneeuro")
+    {
+        settings.filter = OneEuro;
+        if (!params.empty())
+            ok = (sscanf(params.c_str(), "%f,%f,%f", &settings.minCutoff,
+                         &settings.beta, &settings.derivativeCutoff) >= 1) &&
+                (settings.minCutoff > 0) && (settings.beta >= 0) &&
+                (settings.derivativeCutoff > 0);
+    }
+    else
+    {
+        ok = false;
+    }
+    if (!ok)
+        throw std::invalid_argument("Stabilizer: malformed filter \"" + spec + "\"");
+    return settings;
+}
+
+Stabilizer::Stabilizer(const Settings& settings)
+{
+    setSettings(settings);
+}
+
+void Stabilizer::setSettings(const Settings& settings)
+{
+    _settings = settings;
+    _settings.window = std::max(1, std::min(int(WindowMax), _settings.window));
+    reset();
+}
+
+const Stabilizer::Settings& Stabilizer::settings() const
+{
+    return _settings;
+}
+
+void Stabilizer::reset()
+{
+    _oldest = 0;
+    _count = 0;
+    std::fill(_sum, _sum + Lanes, 0.0f);
+    std::fill(_value, _value + Lanes, 0.0f);
+    std::fill(_derivative, _derivative + Lanes, 0.0f);
+    _time = 0;
+}
+
+void Stabilizer::update(const float* sample, double time, float* filtered)
+{
+    Vec4 x = Vec4::loadu(sample);
+
+    if (_settings.filter == MovingAverage)
+    {
+        // Replace the oldest sample in the window, once it is full, and
+        // keep the sum current rather than summing the window again.  The
+        // face's values are whole pixels, so the sum stays exact.
+
+        Vec4 sum = Vec4::load(_sum);
+        int slot;
+        if (_count < _settings.window)
+        {
+            slot = _count++;
+        }
+        else
+        {
+            slot = _oldest;
+            sum = sum - Vec4::load(_ring[slot]);
+            _oldest = (_oldest + 1 == _settings.window) ? 0 : _oldest + 1;
+        }
+        x.store(_ring[slot]);
+        sum = sum + x;
+        sum.store(_sum);
+        (sum * Vec4(1.0f / _count)).storeu(filtered);
+        return;
+    }
+
+    // The first sample passes through unchanged.
+
+    if (_count == 0)
+    {
+        _count = 1;
+        x.store(_value);
+        std::fill(_derivative, _derivative + Lanes, 0.0f);
+        _time = time;
+        x.storeu(filtered);
+        return;
+    }
+
+    Vec4 value = Vec4::load(_value);
+    Vec4 alpha(_settings.smoothing);
+    if (_settings.filter == OneEuro)
+    {
+        // A repeated time would make the rates infinite, so treat the
+        // samples as a microsecond apart.
+
+        Vec4 dt(float(std::max(time - _time, 1e-6)));
+        _time = time;
+
+        Vec4 derivative = Vec4::load(_derivative);
+        Vec4 rate = (x - value) / dt;
+        derivative = derivative +
+            oneEuroAlpha(Vec4(_settings.derivativeCutoff), dt) * (rate - derivative);
+        derivative.store(_derivative);
+
+        Vec4 cutoff = Vec4(_settings.minCutoff) + Vec4(_settings.beta) * derivative.abs();
+        alpha = oneEuroAlpha(cutoff, dt);
+    }
+
+    value = value + alpha * (x - value);
+    value.store(_value);
+    value.storeu(filtered);
+}
@@ -0,0 +1,123 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// FacetiousStabilizer.h
+//
+// Stabilizer: Smooths the jitter in the face rectangle from the detector,
+// filtering its four values (x, y, width and height) together as the four
+// lanes of one vector, with SSE2 when the compiler targets it.  The state
+// is in floating point, held in fixed arrays, so an update takes constant
+// time and never allocates.  There are three filters:
+//
+// MovingAverage: the mean of the last "window" samples, like the
+// Aut::RunningAverage instances it replaces.  Its lag is half the window
+// whether the face is still or moving.
+//
+// ExponentialAverage: each output moves a fraction "smoothing" of the way
+// from the previous output to the new sample.
+//
+// OneEuro: the "1€ filter" of Casiez, Roussel and Vogel (CHI 2012), an
+// exponential average whose cutoff frequency rises with the speed of the
+// signal, so a still face is smoothed heavily and a moving face is
+// followed with little lag.  The cutoff is "minCutoff" plus "beta" times
+// the speed, in pixels per second, which is itself smoothed with the cutoff
+// "derivativeCutoff".
+//
+
+#ifndef __FacetiousStabilizer__
+#define __FacetiousStabilizer__
+
+#include <string>
+
+class Stabilizer
+{
+public:
+
+    enum Filter
+    {
+        MovingAverage,
+        ExponentialAverage,
+        OneEuro
+    };
+
+    enum { Lanes = 4, WindowMax = 64 };
+
+    // The filter and its parameters.  The default OneEuro parameters suit
+    // a face tracked at 30 frames per second with a few pixels of jitter.
+
+    struct Settings
+    {
+        Settings() : filter(OneEuro), window(10), smoothing(0.3f),
+            minCutoff(0.3f), beta(0.02f), derivativeCutoff(1.0f) {}
+        Filter          filter;
+        int             window;
+        float           smoothing;
+        float           minCutoff;
+        float           beta;
+        float           derivativeCutoff;
+    };
+
+    // Settings from a specification of the form "average:WINDOW",
+    // "exponential:SMOOTHING" or "oneeuro:MINCUTOFF,BETA[,DCUTOFF]", with
+    // the parameters not given keeping their defaults.  Throws an exception
+    // if the specification is malformed.
+
+    static Settings     parse(const std::string& spec);
+
+    Stabilizer(const Settings& settings = Settings());
+
+    // Changing the settings restarts the filter.
+
+    void                setSettings(const Settings& settings);
+    const Settings&     settings() const;
+
+    // Forget the samples so far, so the next one passes through unchanged.
+
+    void                reset();
+
+    // Add the "Lanes" values of "sample", taken at "time" in seconds, and
+    // set "filtered" to the stabilized values.  Only the OneEuro filter
+    // uses the time, which must increase from one sample to the next.
+
+    void                update(const float* sample, double time, float* filtered);
+
+private:
+    Settings            _settings;
+
+    // The last "_settings.window" samples, for the moving average, the
+    // index of the oldest, their sum and how many there are.
+
+    alignas(16) float   _ring[WindowMax][Lanes];
+    int                 _oldest;
+    int                 _count;
+    alignas(16) float   _sum[Lanes];
+
+    // The previous output, its smoothed derivative and the previous
+    // sample's time, for the exponential filters.
+
+    alignas(16) float   _value[Lanes];
+    alignas(16) float   _derivative[Lanes];
+    double              _time;
+};
+
+#endif
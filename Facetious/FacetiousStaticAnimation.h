@@ -0,0 +1,302 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// FacetiousStaticAnimation.h
+//
+// StaticAnimation: An animation like Animation, but described entirely by
+// its template arguments, so the sequence of segments, each segment's
+// channel, values, duration and easing curve are all resolved at compile
+// time.  Evaluation is then a fixed sequence of arithmetic with constant
+// operands, with no loop over a list of segments and nothing to allocate.
+// There is also a batched evaluation of many independent instances of the
+// animation, each at its own time, for driving many animated faces at once.
+// It is vectorized with SSE2 when the compiler targets it, four instances
+// at a time, with a scalar fallback otherwise.
+//
+// The values of a segment are integers, since C++11 does not allow
+// floating-point template arguments, and its duration is in milliseconds.
+//
+// TurnAndNodAnimation: The application's animation, rotating to the left,
+// to the right and back to the center, then down, up and back to the
+// center.
+//
+
+#ifndef __FacetiousStaticAnimation__
+#define __FacetiousStaticAnimation__
+
+#include "FacetiousAnimation.h"
+
+#include <algorithm>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Easing curves, mapping the fraction "u" of a segment's duration, from 0
+// to 1, to an interpolation weight, for one value and for four.
+
+struct EaseLinear
+{
+    static float        weight(float u) { return u; }
+#if defined(__SSE2__)
+    static __m128       weight(__m128 u) { return u; }
+#endif
+};
+
+struct EaseInOut
+{
+    static float        weight(float u) { return u * u * (3.0f - 2.0f * u); }
+#if defined(__SSE2__)
+    static __m128       weight(__m128 u)
+    {
+        __m128 slope = _mm_sub_ps(_mm_set1_ps(3.0f), _mm_add_ps(u, u));
+        return _mm_mul_ps(_mm_mul_ps(u, u), slope);
+    }
+#endif
+};
+
+// Move channel "Channel" from "From" to "To" over "DurationMs"
+// milliseconds, with the weights of "Ease".
+
+template <size_t Channel, int From, int To, int64_t DurationMs,
+          typename Ease = EaseInOut>
+struct StaticSegment
+{
+    static_assert(DurationMs > 0, "a segment must have a positive duration");
+
+    enum { channel = Channel };
+    static const int64_t durationMs = DurationMs;
+
+    static float        value(float u)
+    {
+        return float(From) + float(To - From) * Ease::weight(u);
+    }
+#if defined(__SSE2__)
+    static __m128       value(__m128 u)
+    {
+        __m128 change = _mm_mul_ps(_mm_set1_ps(float(To - From)), Ease::weight(u));
+        return _mm_add_ps(_mm_set1_ps(float(From)), change);
+    }
+#endif
+    static float        to() { return float(To); }
+};
+
+namespace StaticAnimationDetail
+{
+    // The segments from "Segments", which start "StartMs" milliseconds into
+    // the animation, unrolled by recursion.
+
+    template <int64_t StartMs, typename... Segments>
+    struct Evaluator
+    {
+        static const size_t channelCount = 0;
+        static const int64_t lengthMs = 0;
+
+        static void     ends(float*) {}
+        static void     eval(AnimationClock::Duration, float*) {}
+        static void     evalBatch(const float*, size_t, float* const*) {}
+    };
+
+    template <int64_t StartMs, typename Segment, typename... Rest>
+    struct Evaluator<StartMs, Segment, Rest...>
+    {
+        typedef Evaluator<StartMs + Segment::durationMs, Rest...> Next;
+
+        static const size_t channelCount =
+            (size_t(Segment::channel) + 1 > Next::channelCount) ?
+            size_t(Segment::channel) + 1 : Next::channelCount;
+        static const int64_t lengthMs = Segment::durationMs + Next::lengthMs;
+
+        // Set each channel to the end of its last segment.
+
+        static void ends(float* values)
+        {
+            values[Segment::channel] = Segment::to();
+            Next::ends(values);
+        }
+
+        // The segments that have started by "t" set their channels in
+        // order, so the latest one to start wins.
+
+        static void eval(AnimationClock::Duration t, float* values)
+        {
+            typedef std::chrono::milliseconds Ms;
+            const AnimationClock::Duration start = Ms(StartMs);
+            const AnimationClock::Duration duration = Ms(int64_t(Segment::durationMs));
+            if (t < start)
+                return;
+            float u = std::min(1.0f, float(double((t - start).count()) / duration.count()));
+            values[Segment::channel] = Segment::value(u);
+            Next::eval(t, values);
+        }
+
+        // The same for "count" instances, at the times in seconds in "t".
+        // The vectorized version computes every instance's value and
+        // selects it with a mask where the segment has started.
+
+        static void evalBatch(const float* t, size_t count, float* const* values)
+        {
+            const float start = float(StartMs) / 1000.0f;
+            const float rate = 1000.0f / float(Segment::durationMs);
+            float* channel = values[Segment::channel];
+            size_t i = 0;
+
+#if defined(__SSE2__)
+            const __m128 start4 = _mm_set1_ps(start);
+            const __m128 rate4 = _mm_set1_ps(rate);
+            const __m128 zero = _mm_setzero_ps();
+            const __m128 one = _mm_set1_ps(1.0f);
+            for (; i + 4 <= count; i += 4)
+            {
+                __m128 time = _mm_loadu_ps(t + i);
+                __m128 u = _mm_mul_ps(_mm_sub_ps(time, start4), rate4);
+                u = _mm_min_ps(_mm_max_ps(u, zero), one);
+                __m128 value = Segment::value(u);
+                __m128 started = _mm_cmpge_ps(time, start4);
+                __m128 previous = _mm_loadu_ps(channel + i);
+                _mm_storeu_ps(channel + i, _mm_or_ps(_mm_and_ps(started, value),
+                                                     _mm_andnot_ps(started, previous)));
+            }
+#endif
+
+            for (; i < count; ++i)
+            {
+                if (t[i] < start)
+                    continue;
+                float u = std::min(1.0f, (t[i] - start) * rate);
+                channel[i] = Segment::value(u);
+            }
+            Next::evalBatch(t, count, values);
+        }
+    };
+}
+
+template <typename... Segments>
+class StaticAnimation
+{
+public:
+
+    typedef AnimationClock::Duration Duration;
+    typedef StaticAnimationDetail::Evaluator<0, Segments...> Evaluator;
+
+    static const size_t channelCount = Evaluator::channelCount;
+    static const int64_t lengthMs = Evaluator::lengthMs;
+
+    static_assert(lengthMs > 0, "an animation must have a segment");
+
+    // The duration of one pass through the segments.
+
+    static Duration     length() { return std::chrono::milliseconds(int64_t(lengthMs)); }
+
+    // Set "values[i]", for each channel i from 0 to channelCount - 1, to
+    // the channel's value at time "t", with the same result as
+    // Animation<float>::eval() for the same segments.  A channel with no
+    // segments keeps its value.
+
+    static void eval(Duration t, float* values)
+    {
+        t %= length();
+        if (t < Duration(0))
+            t += length();
+        Evaluator::ends(values);
+        Evaluator::eval(t, values);
+    }
+
+    // Evaluate "count" independent instances of the animation, instance i
+    // at time "t[i]" in seconds, into "values[c][i]" for each channel c.
+    // Each "values[c]" is an array of "count" floats.  A channel with no
+    // segments is set to 0.
+
+    static void evalBatch(const float* t, size_t count, float* const* values)
+    {
+        // Process a block at a time, so a block's times stay in the cache
+        // through the pass over every segment.
+
+        const size_t blockSize = 256;
+        const float length = float(lengthMs) / 1000.0f;
+        const float lengthInverse = 1.0f / length;
+        float wrapped[blockSize];
+        float* blockValues[channelCount];
+        for (size_t begin = 0; begin < count; begin += blockSize)
+        {
+            size_t n = std::min(blockSize, count - begin);
+
+            // Wrap the times into one pass, truncating rather than calling
+            // floor(), which SSE2 does not have.
+
+            size_t i = 0;
+#if defined(__SSE2__)
+            const __m128 length4 = _mm_set1_ps(length);
+            const __m128 lengthInverse4 = _mm_set1_ps(lengthInverse);
+            for (; i + 4 <= n; i += 4)
+            {
+                __m128 time = _mm_loadu_ps(t + begin + i);
+                __m128 pass = _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_mul_ps(time, lengthInverse4)));
+                __m128 w = _mm_sub_ps(time, _mm_mul_ps(pass, length4));
+                __m128 negative = _mm_cmplt_ps(w, _mm_setzero_ps());
+                _mm_storeu_ps(wrapped + i, _mm_add_ps(w, _mm_and_ps(negative, length4)));
+            }
+#endif
+            for (; i < n; ++i)
+            {
+                float time = t[begin + i];
+                float pass = float(int(time * lengthInverse));
+                float w = time - pass * length;
+                wrapped[i] = (w < 0.0f) ? w + length : w;
+            }
+
+            float ends[channelCount] = {};
+            Evaluator::ends(ends);
+            for (size_t c = 0; c < channelCount; ++c)
+            {
+                blockValues[c] = values[c] + begin;
+                std::fill(blockValues[c], blockValues[c] + n, ends[c]);
+            }
+
+            Evaluator::evalBatch(wrapped, n, blockValues);
+        }
+    }
+};
+
+// The application's animation.
+
+struct TurnAndNodAnimation
+{
+    enum Channel
+    {
+        RotAngleX,
+        RotAngleY,
+        ChannelCount
+    };
+
+    typedef StaticAnimation<StaticSegment<RotAngleY,   0,  50,  5000>,
+                            StaticSegment<RotAngleY,  50, -50, 10000>,
+                            StaticSegment<RotAngleY, -50,   0,  5000>,
+                            StaticSegment<RotAngleX,   0,  50,  5000>,
+                            StaticSegment<RotAngleX,  50, -50, 10000>,
+                            StaticSegment<RotAngleX, -50,   0,  5000> > Type;
+};
+
+#endif
@@ -0,0 +1,213 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+//  FacetiousStats.cpp
+//
+
+#include "FacetiousStats.h"
+
+#include <algorithm>
+#include <iomanip>
+
+namespace
+{
+    const std::memory_order relaxed = std::memory_order_relaxed;
+}
+
+LatencyHistogram::LatencyHistogram()
+{
+    clear();
+}
+
+void LatencyHistogram::record(Clock::duration duration)
+{
+    uint64_t ns = uint64_t(std::max<int64_t>(0,
+        std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count()));
+
+    // The bucket is one more than the index of the highest set bit of the
+    // whole microseconds.
+
+    uint64_t us = ns / 1000;
+    size_t i = 0;
+    while (us && (i + 1 < bucketCount))
+    {
+        us >>= 1;
+        ++i;
+    }
+
+    _buckets[i].fetch_add(1, relaxed);
+    _count.fetch_add(1, relaxed);
+    _totalNs.fetch_add(ns, relaxed);
+
+    uint64_t max = _maxNs.load(relaxed);
+    while ((ns > max) && !_maxNs.compare_exchange_weak(max, ns, relaxed))
+        ;
+}
+
+void LatencyHistogram::clear()
+{
+    for (size_t i = 0; i < bucketCount; ++i)
+        _buckets[i].store(0, relaxed);
+    _count.store(0, relaxed);
+    _totalNs.store(0, relaxed);
+    _maxNs.store(0, relaxed);
+}
+
+uint64_t LatencyHistogram::count() const
+{
+    return _count.load(relaxed);
+}
+
+uint64_t LatencyHistogram::bucket(size_t i) const
+{
+    return _buckets[i].load(relaxed);
+}
+
+double LatencyHistogram::meanUs() const
+{
+    uint64_t n = count();
+    return n ? _totalNs.load(relaxed) / 1000.0 / n : 0.0;
+}
+
+double LatencyHistogram::maxUs() const
+{
+    return _maxNs.load(relaxed) / 1000.0;
+}
+
+double LatencyHistogram::quantileUs(double q) const
+{
+    // Count the buckets rather than using count(), which a concurrent
+    // record() may have updated separately.
+
+    uint64_t n = 0;
+    for (size_t i = 0; i < bucketCount; ++i)
+        n += bucket(i);
+    if (n == 0)
+        return 0.0;
+
+    uint64_t rank = uint64_t(std::max(0.0, std::min(1.0, q)) * (n - 1));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < bucketCount; ++i)
+    {
+        seen += bucket(i);
+        if (seen > rank)
+            return std::min(double(uint64_t(1) << i), maxUs());
+    }
+    return maxUs();
+}
+
+LatencyHistogram::Timer::Timer(LatencyHistogram& histogram) :
+    _histogram(histogram), _start(Clock::now())
+{
+}
+
+LatencyHistogram::Timer::~Timer()
+{
+    _histogram.record(Clock::now() - _start);
+}
+
+//
+
+Stats::Stats()
+{
+    for (size_t i = 0; i < CounterCount; ++i)
+        _counters[i].store(0, relaxed);
+}
+
+LatencyHistogram& Stats::histogram(Stage stage)
+{
+    return _histograms[stage];
+}
+
+const LatencyHistogram& Stats::histogram(Stage stage) const
+{
+    return _histograms[stage];
+}
+
+void Stats::add(Counter counter, uint64_t n)
+{
+    _counters[counter].fetch_add(n, relaxed);
+}
+
+uint64_t Stats::count(Counter counter) const
+{
+    return _counters[counter].load(relaxed);
+}
+
+const char* Stats::name(Stage stage)
+{
+    static const char* names[StageCount] =
+    {
+        "submit", "queue", "track", "detect", "reduce", "publish", "upload",
+        "draw", "draw front", "draw back", "capture to display"
+    };
+    return names[stage];
+}
+
+const char* Stats::name(Counter counter)
+{
+    static const char* names[CounterCount] =
+    {
+        "frames captured", "frames dropped", "detections no face",
+        "deliveries empty", "frames rendered", "frames reused"
+    };
+    return names[counter];
+}
+
+void Stats::clear()
+{
+    for (size_t i = 0; i < StageCount; ++i)
+        _histograms[i].clear();
+    for (size_t i = 0; i < CounterCount; ++i)
+        _counters[i].store(0, relaxed);
+}
+
+void Stats::dump(std::ostream& out) const
+{
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << std::fixed << std::setprecision(1);
+
+    for (size_t i = 0; i < CounterCount; ++i)
+        out << std::setw(20) << std::left << name(Counter(i)) << std::right
+            << count(Counter(i)) << "\n";
+
+    out << std::setw(20) << std::left << "stage (us)" << std::right
+        << std::setw(10) << "count" << std::setw(10) << "mean"
+        << std::setw(10) << "p50" << std::setw(10) << "p99"
+        << std::setw(12) << "max" << "\n";
+    for (size_t i = 0; i < StageCount; ++i)
+    {
+        const LatencyHistogram& h = histogram(Stage(i));
+        if (h.count() == 0)
+            continue;
+        out << std::setw(20) << std::left << name(Stage(i)) << std::right
+            << std::setw(10) << h.count() << std::setw(10) << h.meanUs()
+            << std::setw(10) << h.quantileUs(0.5)
+            << std::setw(10) << h.quantileUs(0.99)
+            << std::setw(12) << h.maxUs() << "\n";
+    }
+
+    out.flags(flags);
+    out.precision(precision);
+}
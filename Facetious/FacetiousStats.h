@@ -0,0 +1,176 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// FacetiousStats.h
+//
+// LatencyHistogram: A histogram of durations with fixed buckets, one for
+// each power of two microseconds, plus the total and maximum.  Recording
+// a duration is a few relaxed atomic operations, with no lock and no
+// allocation, so it can be done from any thread on the hot path.
+//
+// Stats: The latency histograms and counters for each stage of the
+// capture, detect, reduce, publish, upload and draw chain.  The
+// FramePipeline owns one and records the stages it runs; the renderer
+// records the rest into the same one.  dump() prints a summary.
+//
+
+#ifndef __FacetiousStats__
+#define __FacetiousStats__
+
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#include <stdint.h>
+#include <stddef.h>
+
+class LatencyHistogram
+{
+public:
+
+    typedef std::chrono::steady_clock Clock;
+
+    // Bucket 0 holds durations under 1 microsecond, and bucket i holds
+    // those from 2^(i-1) up to 2^i microseconds.  The last bucket also
+    // holds anything longer.
+
+    static const size_t bucketCount = 28;
+
+    LatencyHistogram();
+
+    void                record(Clock::duration duration);
+
+    // Remove all the recorded durations.  Not atomic with respect to
+    // concurrent calls to record().
+
+    void                clear();
+
+    uint64_t            count() const;
+    uint64_t            bucket(size_t i) const;
+    double              meanUs() const;
+    double              maxUs() const;
+
+    // The upper bound of the bucket holding the fraction "q" (from 0 to 1)
+    // of the durations, or the maximum if it is lower, in microseconds, or
+    // 0 if there are none.
+
+    double              quantileUs(double q) const;
+
+    // Records the time from its construction to its destruction.
+
+    class Timer
+    {
+    public:
+        Timer(LatencyHistogram& histogram);
+        ~Timer();
+
+    private:
+        LatencyHistogram& _histogram;
+        Clock::time_point _start;
+    };
+
+private:
+    LatencyHistogram(const LatencyHistogram&);
+    LatencyHistogram& operator=(const LatencyHistogram&);
+
+    std::atomic<uint64_t> _buckets[bucketCount];
+    std::atomic<uint64_t> _count;
+    std::atomic<uint64_t> _totalNs;
+    std::atomic<uint64_t> _maxNs;
+};
+
+class Stats
+{
+public:
+
+    // The stages that are timed.  Queue is the wait from a frame's capture
+    // until a worker takes it.  Upload is the sink's handling of a face
+    // image, including the texture upload.  DrawFront and DrawBack are
+    // the shader programs' draw() calls for the two surfaces, which
+    // measure the CPU's submission of the work, not the GPU's execution.
+    // When one program draws both surfaces, DrawFront includes the back.
+    // CaptureToDisplay is the time from a frame's capture until the first
+    // draw() that shows its face.
+
+    enum Stage
+    {
+        Submit,
+        Queue,
+        Track,
+        Detect,
+        Reduce,
+        Publish,
+        Upload,
+        Draw,
+        DrawFront,
+        DrawBack,
+        CaptureToDisplay,
+        StageCount
+    };
+
+    // The events that are counted.  FramesDropped counts frames replaced
+    // by a newer one before any worker took them.  DeliveriesEmpty counts
+    // calls to FramePipeline::deliver() that had no new face image, which
+    // is most draws when rendering faster than the camera; no upload is
+    // ever lost, since deliver() takes the newest image without waiting.
+    // FramesReused counts redraws that re-presented the last frame.
+
+    enum Counter
+    {
+        FramesCaptured,
+        FramesDropped,
+        DetectionsNoFace,
+        DeliveriesEmpty,
+        FramesRendered,
+        FramesReused,
+        CounterCount
+    };
+
+    Stats();
+
+    LatencyHistogram&   histogram(Stage stage);
+    const LatencyHistogram& histogram(Stage stage) const;
+
+    void                add(Counter counter, uint64_t n = 1);
+    uint64_t            count(Counter counter) const;
+
+    static const char*  name(Stage stage);
+    static const char*  name(Counter counter);
+
+    // Clear all the histograms and counters.
+
+    void                clear();
+
+    // Print the counters, and for each stage that has been recorded, the
+    // count, mean, median, 99th percentile and maximum.
+
+    void                dump(std::ostream& out) const;
+
+private:
+    Stats(const Stats&);
+    Stats& operator=(const Stats&);
+
+    LatencyHistogram    _histograms[StageCount];
+    std::atomic<uint64_t> _counters[CounterCount];
+};
+
+#endif
@@ -0,0 +1,333 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+//  FacetiousSyntheticSource.cpp
+//
+
+#include "FacetiousSyntheticSource.h"
+
+#include <atomic>
+#include <cmath>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    // A read-only mapping of a file, unmapped when the last frame referring
+    // to it is destroyed.
+
+    class Mapping
+    {
+    public:
+        Mapping(const std::string& path);
+        ~Mapping();
+        const uint8_t*  data() const { return _data; }
+        size_t          size() const { return _size; }
+    private:
+        const uint8_t*  _data;
+        size_t          _size;
+    };
+
+    Mapping::Mapping(const std::string& path) :
+        _data(0), _size(0)
+    {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("SyntheticSource: cannot open " + path);
+
+        struct stat st;
+        if ((fstat(fd, &st) != 0) || (st.st_size == 0))
+        {
+            close(fd);
+            throw std::runtime_error("SyntheticSource: cannot read " + path);
+        }
+
+        void* p = mmap(0, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED)
+            throw std::runtime_error("SyntheticSource: cannot map " + path);
+
+        _data = static_cast<const uint8_t*>(p);
+        _size = size_t(st.st_size);
+    }
+
+    Mapping::~Mapping()
+    {
+        munmap(const_cast<uint8_t*>(_data), _size);
+    }
+}
+
+class SyntheticSource::Imp
+{
+public:
+    Imp(int w, int h, double f) :
+        width(w), height(h), fps(f), pipeline(0), thread(0),
+        runThread(false), framesSubmitted(0) {}
+
+    void                               threadFunc();
+
+    int                                width;
+    int                                height;
+    double                             fps;
+
+    // The pixels of each frame in the loop.  For a file, they all share
+    // ownership of the mapping.
+
+    std::vector<std::shared_ptr<const uint8_t> > frames;
+
+    FramePipeline*                     pipeline;
+    std::thread*                       thread;
+
+    // For stopping the thread.
+
+    std::mutex                         runThreadMutex;
+    bool                               runThread;
+
+    std::atomic<long>                  framesSubmitted;
+};
+
+void SyntheticSource::Imp::threadFunc()
+{
+    // Pace the frames against absolute deadlines, so the rate does not
+    // drift with the time taken to submit each one.
+
+    typedef FramePipeline::Clock Clock;
+    Clock::duration period = (fps > 0) ?
+        std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / fps)) :
+        Clock::duration::zero();
+    Clock::time_point next = Clock::now();
+
+    size_t i = 0;
+    bool keepGoing = true;
+    while (keepGoing)
+    {
+        pipeline->submit(new FramePipeline::RawFrame(frames[i], width, height));
+        ++framesSubmitted;
+        i = (i + 1) % frames.size();
+
+        if (period != Clock::duration::zero())
+        {
+            next += period;
+
+            // If the thread has fallen more than a period behind (e.g.,
+            // it was descheduled, or submitting is slow), drop the frames
+            // it missed rather than submitting them in a burst, and pace
+            // the rest from now.
+
+            Clock::time_point now = Clock::now();
+            if (now - next > period)
+            {
+                i = (i + size_t((now - next) / period)) % frames.size();
+                next = now;
+            }
+            std::this_thread::sleep_until(next);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(runThreadMutex);
+            if (!runThread)
+                keepGoing = false;
+        }
+    }
+}
+
+//
+
+SyntheticSource::SyntheticSource(int width, int height, double fps) :
+    _m(new Imp(width, height, fps))
+{
+    // The face moves around an ellipse, growing and shrinking, over a
+    // two-second loop at 30 frames per second.  Rather than generating
+    // every frame, generate a few images taller than a frame, one for each
+    // size of the face, and make each frame a view into one of them at an
+    // offset that moves the face (and the background with it).  Offsetting
+    // by whole rows moves it vertically, and by pixels, horizontally, with
+    // the pixels shifted past one edge of a row appearing at the other.
+
+    const int cycleFrames = 60;
+    const int sizes = 3;
+    const int marginY = int(ceil(height * 0.1)) + 2;
+    const int imageHeight = height + 2 * marginY;
+
+    std::shared_ptr<const uint8_t> images[sizes];
+    for (int k = 0; k < sizes; ++k)
+    {
+        double s = 2.0 * k / (sizes - 1) - 1;
+        int radius = int(height * (0.25 + 0.02 * s));
+        images[k] = makeProceduralImage(width, imageHeight, width / 2, imageHeight / 2,
+                                        radius);
+    }
+
+    for (int i = 0; i < cycleFrames; ++i)
+    {
+        double a = 2 * M_PI * i / cycleFrames;
+        int centerX = int(width * (0.5 + 0.15 * cos(a)));
+        int centerY = int(height * (0.5 + 0.1 * sin(a)));
+        int k = int(floor((sin(2 * a) + 1) / 2 * (sizes - 1) + 0.5));
+
+        // The image's row and column that are the frame's top left.  The
+        // margin keeps the row at least 1, so the column may be negative.
+
+        int row = imageHeight / 2 - centerY;
+        int column = width / 2 - centerX;
+        size_t offset = (ptrdiff_t(row) * width + column) * 4;
+        _m->frames.push_back(std::shared_ptr<const uint8_t>(images[k],
+                                                            images[k].get() + offset));
+    }
+}
+
+SyntheticSource::SyntheticSource(const std::string& path, int width, int height,
+                                 double fps) :
+    _m(new Imp(width, height, fps))
+{
+    std::shared_ptr<Mapping> mapping(new Mapping(path));
+
+    const size_t frameBytes = size_t(width) * height * 4;
+    const size_t n = (frameBytes > 0) ? mapping->size() / frameBytes : 0;
+    if (n == 0)
+        throw std::runtime_error("SyntheticSource: no complete frame in " + path);
+
+    // Each frame's pointer shares ownership of the whole mapping.
+
+    for (size_t i = 0; i < n; ++i)
+        _m->frames.push_back(std::shared_ptr<const uint8_t>(mapping,
+                                                            mapping->data() + i * frameBytes));
+}
+
+SyntheticSource::~SyntheticSource()
+{
+    stop();
+}
+
+SyntheticSource* SyntheticSource::create(const std::string& spec)
+{
+    std::string kind, path, geometry;
+    size_t colon = spec.find(':');
+    size_t lastColon = spec.rfind(':');
+    if (colon == std::string::npos)
+        throw std::invalid_argument("SyntheticSource: malformed source \"" + spec + "\"");
+
+    kind = spec.substr(0, colon);
+    geometry = spec.substr(lastColon + 1);
+    if (kind == "file")
+    {
+        if (lastColon == colon)
+            throw std::invalid_argument("SyntheticSource: malformed source \"" + spec + "\"");
+        path = spec.substr(colon + 1, lastColon - colon - 1);
+    }
+    else if ((kind != "procedural") || (lastColon != colon))
+    {
+        throw std::invalid_argument("SyntheticSource: malformed source \"" + spec + "\"");
+    }
+
+    int width = 0, height = 0;
+    double fps = 30.0;
+    int n = sscanf(geometry.c_str(), "%dx%d@%lf", &width, &height, &fps);
+    if ((n < 2) || (width <= 0) || (height <= 0) || (fps < 0))
+        throw std::invalid_argument("SyntheticSource: malformed size in \"" + spec + "\"");
+
+    if (kind == "file")
+        return new SyntheticSource(path, width, height, fps);
+    else
+        return new SyntheticSource(width, height, fps);
+}
+
+void SyntheticSource::start(FramePipeline* pipeline)
+{
+    if (_m->thread)
+        return;
+
+    _m->pipeline = pipeline;
+    _m->runThread = true;
+    _m->thread = new std::thread(std::bind(&Imp::threadFunc, _m.get()));
+}
+
+void SyntheticSource::stop()
+{
+    if (!_m->thread)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(_m->runThreadMutex);
+        _m->runThread = false;
+    }
+
+    _m->thread->join();
+    delete _m->thread;
+    _m->thread = 0;
+}
+
+int SyntheticSource::width() const
+{
+    return _m->width;
+}
+
+int SyntheticSource::height() const
+{
+    return _m->height;
+}
+
+long SyntheticSource::framesSubmitted() const
+{
+    return _m->framesSubmitted;
+}
+
+std::shared_ptr<const uint8_t> SyntheticSource::makeProceduralImage(int width, int height,
+                                                                    int centerX, int centerY,
+                                                                    int radius)
+{
+    uint8_t* pixels = new uint8_t [size_t(width) * height * 4];
+    uint8_t* p = pixels;
+    for (int j = 0; j < height; ++j)
+    {
+        for (int i = 0; i < width; ++i, p += 4)
+        {
+            int dx = i - centerX;
+            int dy = j - centerY;
+            int d2 = dx * dx + dy * dy;
+            uint8_t v;
+            if (d2 < radius * radius)
+            {
+                // Shade the disc so it has some relief as a height field.
+
+                v = uint8_t(255 - 100 * d2 / (radius * radius));
+            }
+            else
+            {
+                // A dim, textured background.
+
+                v = uint8_t(((i ^ j) & 0x1f) + 16);
+            }
+            p[0] = p[1] = p[2] = v;
+            p[3] = 255;
+        }
+    }
+    return std::shared_ptr<const uint8_t>(pixels, std::default_delete<uint8_t[]>());
+}
@@ -0,0 +1,98 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// FacetiousSyntheticSource.h
+//
+// SyntheticSource: A FramePipeline::Source that replaces the camera with
+// frames of raw RGBA pixels, either streamed from a memory-mapped file or
+// generated procedurally.  Frames are submitted at a configurable rate, or
+// as fast as possible, which makes throughput measurements independent of
+// the lighting and the frame rate of a real camera.
+//
+// A file contains frames of width * height * 4 bytes each, one after the
+// other, with the top row of each frame first.  The source loops over the
+// file's frames.  Procedural frames show a bright, shaded disc (the "face")
+// moving over a dim background; they are views into a few images generated
+// once, in the constructor, so producing a frame costs almost nothing, and
+// the images take little more memory than a few frames.
+//
+
+#ifndef __FacetiousSyntheticSource__
+#define __FacetiousSyntheticSource__
+
+#include "FacetiousFramePipeline.h"
+
+#include <string>
+
+class SyntheticSource : public FramePipeline::Source
+{
+public:
+
+    // A source of procedurally generated frames.  A "fps" of 0 means as
+    // fast as possible.
+
+    SyntheticSource(int width, int height, double fps);
+
+    // A source of frames from the file at "path".  Throws an exception if
+    // the file cannot be mapped or holds no complete frame.
+
+    SyntheticSource(const std::string& path, int width, int height, double fps);
+
+    virtual ~SyntheticSource();
+
+    // Create a source from a specification of the form
+    // "procedural:WIDTHxHEIGHT@FPS" or "file:PATH:WIDTHxHEIGHT@FPS", where
+    // "@FPS" is optional and defaults to 30.  Throws an exception if the
+    // specification is malformed.
+
+    static SyntheticSource* create(const std::string& spec);
+
+    // Start and stop the thread that submits frames to "pipeline".
+
+    virtual void        start(FramePipeline* pipeline);
+    virtual void        stop();
+
+    int                 width() const;
+    int                 height() const;
+
+    // The number of frames submitted so far.
+
+    long                framesSubmitted() const;
+
+    // Returns "width" by "height" RGBA pixels, top row first, with the face
+    // centered at "centerX", "centerY" (in pixels from the top left) and of
+    // the given "radius".
+
+    static std::shared_ptr<const uint8_t> makeProceduralImage(int width, int height,
+                                                              int centerX, int centerY,
+                                                              int radius);
+
+private:
+
+    // Details of the class' data are hidden in the .cpp file.
+
+    class Imp;
+    std::unique_ptr<Imp> _m;
+};
+
+#endif
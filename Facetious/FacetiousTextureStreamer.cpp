@@ -0,0 +1,155 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+//  FacetiousTextureStreamer.cpp
+//
+
+#include "FacetiousTextureStreamer.h"
+
+#include "AglTextureUbyte.h"
+
+#include <algorithm>
+#include <string.h>
+
+namespace
+{
+    const int bytesPerPixel = 4;
+}
+
+TextureStreamer::TextureStreamer(int ringSize) :
+    _slots(std::max(1, ringSize)), _iSlot(0), _width(0), _height(0),
+    _uploads(0), _buffersBusy(0)
+{
+    for (Slot& slot : _slots)
+    {
+        glGenBuffers(1, &slot.buffer);
+        slot.fence = 0;
+        slot.bytes = 0;
+    }
+}
+
+TextureStreamer::~TextureStreamer()
+{
+    for (Slot& slot : _slots)
+    {
+        if (slot.fence)
+            glDeleteSync(slot.fence);
+        glDeleteBuffers(1, &slot.buffer);
+    }
+}
+
+void TextureStreamer::upload(Agl::TextureUbyte* texture, const uint8_t* data,
+                             int width, int height, int rowLength, bool rgba)
+{
+    // Specify the texture's storage only when the size changes.  After
+    // that, the texture is only updated.
+
+    if ((width != _width) || (height != _height))
+    {
+        _blank.assign(size_t(width) * height * bytesPerPixel, 0);
+        texture->setData(&_blank[0], width, height);
+        _width = width;
+        _height = height;
+    }
+
+    Slot& slot = _slots[_iSlot];
+    _iSlot = (_iSlot + 1) % _slots.size();
+
+    // If the GPU has finished reading this buffer for the last upload, it
+    // can be written without synchronization.  Otherwise invalidating it
+    // lets the driver substitute fresh memory rather than wait.
+
+    GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT;
+    if (slot.fence)
+    {
+        GLenum status = glClientWaitSync(slot.fence, 0, 0);
+        if ((status == GL_ALREADY_SIGNALED) || (status == GL_CONDITION_SATISFIED))
+            access |= GL_MAP_UNSYNCHRONIZED_BIT;
+        else
+            ++_buffersBusy;
+        glDeleteSync(slot.fence);
+        slot.fence = 0;
+    }
+
+    const size_t rowBytes = size_t(width) * bytesPerPixel;
+    const size_t bytes = rowBytes * height;
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+    if (slot.bytes < bytes)
+    {
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, 0, GL_STREAM_DRAW);
+        slot.bytes = bytes;
+        access &= ~GL_MAP_UNSYNCHRONIZED_BIT;
+    }
+
+    if (uint8_t* dst = static_cast<uint8_t*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER,
+                                                              0, bytes, access)))
+    {
+        for (int j = 0; j < height; ++j, dst += rowBytes)
+        {
+            const uint8_t* src = data + size_t(j) * rowLength * bytesPerPixel;
+            if (rgba)
+            {
+                for (int i = 0; i < width; ++i)
+                {
+                    dst[i * 4 + 0] = src[i * 4 + 2];
+                    dst[i * 4 + 1] = src[i * 4 + 1];
+                    dst[i * 4 + 2] = src[i * 4 + 0];
+                    dst[i * 4 + 3] = src[i * 4 + 3];
+                }
+            }
+            else
+            {
+                memcpy(dst, src, rowBytes);
+            }
+        }
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+        // The buffer holds compact rows, so reset any unpacking state left
+        // by other uploads.  The source of glTexSubImage2D() is then an
+        // offset into the bound buffer, and the call returns without
+        // waiting for the transfer.
+
+        texture->bind();
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_BGRA,
+                        GL_UNSIGNED_INT_8_8_8_8_REV, 0);
+
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        ++_uploads;
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+uint64_t TextureStreamer::uploads() const
+{
+    return _uploads;
+}
+
+uint64_t TextureStreamer::buffersBusy() const
+{
+    return _buffersBusy;
+}
@@ -0,0 +1,95 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// FacetiousTextureStreamer.h
+//
+// TextureStreamer: Uploads images to an Agl::TextureUbyte through a ring of
+// OpenGL pixel buffer objects, so the calling thread does not wait for the
+// transfer.  Each upload copies the image into the next buffer in the ring,
+// mapped without synchronization when the GPU is done with that buffer,
+// and then has the GPU copy it into the texture with glTexSubImage2D(),
+// using the native BGRA format with GL_UNSIGNED_INT_8_8_8_8_REV.  The
+// texture's storage is specified only when the image size changes.
+//
+// Buffers that stay mapped while other threads write them (persistent
+// mapping) need OpenGL 4.4, and OS X supports only 4.1, so the copy into
+// the mapped buffer is done by the thread with the OpenGL context.  For a
+// face image it is small.
+//
+
+#ifndef __FacetiousTextureStreamer__
+#define __FacetiousTextureStreamer__
+
+#include <OpenGL/gl3.h>
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace Agl
+{
+    class TextureUbyte;
+}
+
+class TextureStreamer
+{
+public:
+
+    // Must be called with the OpenGL context current, as must all the
+    // other routines.  The ring has "ringSize" buffers.
+
+    TextureStreamer(int ringSize = 3);
+    ~TextureStreamer();
+
+    // Upload the "width" by "height" pixels at "data", whose rows are
+    // "rowLength" pixels long, to "texture".  If "rgba" is true, the pixels
+    // are in RGBA order, and they are swizzled to BGRA while being copied
+    // into the buffer; otherwise they are already in BGRA order.
+
+    void                upload(Agl::TextureUbyte* texture, const uint8_t* data,
+                               int width, int height, int rowLength, bool rgba);
+
+    // The number of uploads, and the number that found the next buffer
+    // still in use by the GPU, which the driver then had to replace.
+
+    uint64_t            uploads() const;
+    uint64_t            buffersBusy() const;
+
+private:
+    struct Slot
+    {
+        GLuint          buffer;
+        GLsync          fence;
+        size_t          bytes;
+    };
+
+    std::vector<Slot>   _slots;
+    size_t              _iSlot;
+    int                 _width;
+    int                 _height;
+    std::vector<uint8_t> _blank;
+    uint64_t            _uploads;
+    uint64_t            _buffersBusy;
+};
+
+#endif
@@ -0,0 +1,184 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+//  FacetiousTrace.cpp
+//
+
+#include "FacetiousTrace.h"
+
+#include <algorithm>
+#include <functional>
+#include <iomanip>
+#include <thread>
+#include <vector>
+
+class FrameTrace::Imp
+{
+public:
+    Imp(size_t capacity) :
+        origin(Clock::now()), events(capacity), next(0), lost(0) {}
+
+    struct Event
+    {
+        Event() : ready(false) {}
+        std::atomic<bool>              ready;
+        char                           phase;
+        const char*                    name;
+        uint64_t                       frame;
+        size_t                         thread;
+        int64_t                        beginNs;
+        int64_t                        durationNs;
+    };
+
+    int64_t                            ns(Clock::time_point t) const;
+
+    Clock::time_point                  origin;
+    std::vector<Event>                 events;
+    std::atomic<size_t>                next;
+    std::atomic<uint64_t>              lost;
+};
+
+int64_t FrameTrace::Imp::ns(Clock::time_point t) const
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(t - origin).count();
+}
+
+//
+
+FrameTrace::FrameTrace(size_t capacity) :
+    _m(new Imp(capacity))
+{
+}
+
+FrameTrace::~FrameTrace()
+{
+}
+
+void FrameTrace::record(char phase, const char* name, uint64_t frame,
+                        Clock::time_point begin, Clock::time_point end)
+{
+    size_t i = _m->next.fetch_add(1, std::memory_order_relaxed);
+    if (i >= _m->events.size())
+    {
+        _m->lost.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    Imp::Event& e = _m->events[i];
+    e.phase = phase;
+    e.name = name;
+    e.frame = frame;
+    e.thread = std::hash<std::thread::id>()(std::this_thread::get_id());
+    e.beginNs = _m->ns(begin);
+    e.durationNs = _m->ns(end) - e.beginNs;
+    e.ready.store(true, std::memory_order_release);
+}
+
+void FrameTrace::span(const char* name, uint64_t frame,
+                      Clock::time_point begin, Clock::time_point end)
+{
+    record('X', name, frame, begin, end);
+}
+
+void FrameTrace::frameBegin(uint64_t frame, Clock::time_point time)
+{
+    record('b', "frame", frame, time, time);
+}
+
+void FrameTrace::frameEnd(uint64_t frame, const char* outcome,
+                          Clock::time_point time)
+{
+    record('e', outcome, frame, time, time);
+}
+
+size_t FrameTrace::size() const
+{
+    return std::min(_m->next.load(std::memory_order_relaxed), _m->events.size());
+}
+
+uint64_t FrameTrace::eventsLost() const
+{
+    return _m->lost.load(std::memory_order_relaxed);
+}
+
+void FrameTrace::writeChromeTrace(std::ostream& out) const
+{
+    // Times are in microseconds.  The asynchronous events for a frame's
+    // life share its number as their id, and the outcome goes in the end
+    // event's arguments, since the begin and end must have the same name.
+    // The times are written in fixed point, to the nanosecond, since the
+    // default precision would round them to tens of microseconds after the
+    // first second.  The stream's format is restored afterwards.
+
+    const std::ios::fmtflags flags = out.flags();
+    const std::streamsize precision = out.precision();
+    out << std::fixed << std::setprecision(3);
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    const size_t n = size();
+    for (size_t i = 0; i < n; ++i)
+    {
+        const Imp::Event& e = _m->events[i];
+        if (!e.ready.load(std::memory_order_acquire))
+            continue;
+
+        out << (first ? "\n" : ",\n");
+        first = false;
+
+        bool async = (e.phase != 'X');
+        out << "{\"name\":\"" << (async ? "frame" : e.name)
+            << "\",\"cat\":\"facetious\",\"ph\":\"" << e.phase
+            << "\",\"pid\":1,\"tid\":" << e.thread % 1000000
+            << ",\"ts\":" << e.beginNs / 1000.0;
+        if (async)
+            out << ",\"id\":" << e.frame;
+        else
+            out << ",\"dur\":" << e.durationNs / 1000.0;
+        out << ",\"args\":{\"frame\":" << e.frame;
+        if (e.phase == 'e')
+            out << ",\"outcome\":\"" << e.name << "\"";
+        out << "}}";
+    }
+    out << "\n]}\n";
+
+    out.flags(flags);
+    out.precision(precision);
+}
+
+//
+
+StageTimer::StageTimer(Stats& stats, Stats::Stage stage, FrameTrace* trace,
+                       uint64_t frame) :
+    _histogram(stats.histogram(stage)), _stage(stage), _trace(trace),
+    _frame(frame), _start(FrameTrace::Clock::now())
+{
+}
+
+StageTimer::~StageTimer()
+{
+    FrameTrace::Clock::time_point end = FrameTrace::Clock::now();
+    _histogram.record(end - _start);
+    if (_trace)
+        _trace->span(Stats::name(_stage), _frame, _start, end);
+}
@@ -0,0 +1,123 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// FacetiousTrace.h
+//
+// FrameTrace: A record of where each captured frame spent its time, for
+// viewing in Chrome's trace viewer (chrome://tracing) or Perfetto.  Every
+// frame has the sequence number given by FramePipeline::submit(), and each
+// span of work records the frame it was for, so a rendered face can be
+// followed back to its capture.  A frame's whole life, from capture to the
+// end of its processing, is an asynchronous event keyed by its number,
+// ending with the outcome: published, dropped, stale, no face or skipped.
+//
+// Events go into a buffer of fixed capacity, allocated up front.  Recording
+// one claims a slot with a single atomic increment, so any thread can
+// record without a lock; events beyond the capacity are counted and lost.
+//
+// StageTimer: Times a stage into its Stats histogram and, if there is a
+// trace, records it there too.
+//
+
+#ifndef __FacetiousTrace__
+#define __FacetiousTrace__
+
+#include "FacetiousStats.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <ostream>
+#include <stdint.h>
+#include <stddef.h>
+
+class FrameTrace
+{
+public:
+
+    typedef std::chrono::steady_clock Clock;
+
+    // Room for "capacity" events.  Times in the trace are relative to the
+    // time of construction.
+
+    FrameTrace(size_t capacity = 1 << 18);
+    ~FrameTrace();
+
+    // Record that "frame" spent "begin" to "end" in the stage "name", on
+    // the calling thread.  Names must be string literals, or otherwise
+    // outlive the trace.
+
+    void                span(const char* name, uint64_t frame,
+                             Clock::time_point begin, Clock::time_point end);
+
+    // Record the start of the life of "frame", and its end with "outcome".
+
+    void                frameBegin(uint64_t frame, Clock::time_point time);
+    void                frameEnd(uint64_t frame, const char* outcome,
+                                 Clock::time_point time);
+
+    // The number of events recorded, and the number lost for lack of room.
+
+    size_t              size() const;
+    uint64_t            eventsLost() const;
+
+    // Write the events in Chrome's trace event format (JSON).  Events
+    // still being recorded by other threads are left out.
+
+    void                writeChromeTrace(std::ostream& out) const;
+
+private:
+    FrameTrace(const FrameTrace&);
+    FrameTrace& operator=(const FrameTrace&);
+
+    void                record(char phase, const char* name, uint64_t frame,
+                               Clock::time_point begin, Clock::time_point end);
+
+    // Details of the class' data are hidden in the .cpp file.
+
+    class Imp;
+    std::unique_ptr<Imp> _m;
+};
+
+class StageTimer
+{
+public:
+
+    // "trace" may be null.
+
+    StageTimer(Stats& stats, Stats::Stage stage, FrameTrace* trace,
+               uint64_t frame);
+    ~StageTimer();
+
+private:
+    StageTimer(const StageTimer&);
+    StageTimer& operator=(const StageTimer&);
+
+    LatencyHistogram&   _histogram;
+    Stats::Stage        _stage;
+    FrameTrace*         _trace;
+    uint64_t            _frame;
+    FrameTrace::Clock::time_point _start;
+};
+
+#endif
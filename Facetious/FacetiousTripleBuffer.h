@@ -0,0 +1,124 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// FacetiousTripleBuffer.h
+//
+// TripleBuffer: A wait-free handoff of values from one writer thread to one
+// reader thread.  There are three slots: the writer fills the "back" slot
+// and publishes it, and the reader takes the most recently published slot
+// as its "front" slot.  The third slot holds the latest published value
+// until the reader takes it.  Neither thread ever blocks the other, the
+// writer never overwrites a value the reader is using, and the reader
+// always gets the newest complete value.  Values are reused, so a slot
+// holding a buffer need not reallocate it for each publication.
+//
+
+#ifndef __FacetiousTripleBuffer__
+#define __FacetiousTripleBuffer__
+
+#include <atomic>
+
+template <typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer();
+
+    // For the writer thread: the slot to fill, and the publication of that
+    // slot.  After publish(), back() is a different slot, whose contents are
+    // a value published earlier (or default constructed).
+
+    T&                  back();
+    void                publish();
+
+    // For the reader thread: if a value has been published since the last
+    // call, make it the front slot and return true.  Otherwise the front
+    // slot is unchanged and the return value is false.
+
+    bool                update();
+    T&                  front();
+    const T&            front() const;
+
+private:
+
+    // The middle slot's index is in the low bits of _middle, along with
+    // a bit that is set when the middle slot holds a value the reader has
+    // not yet taken.
+
+    enum { IndexMask = 0x3, NewBit = 0x4 };
+
+    T                   _slots[3];
+    unsigned            _back;
+    std::atomic<unsigned> _middle;
+    unsigned            _front;
+
+    TripleBuffer(const TripleBuffer&);
+    TripleBuffer& operator=(const TripleBuffer&);
+};
+
+template <typename T>
+TripleBuffer<T>::TripleBuffer() :
+    _back(0), _middle(1), _front(2)
+{
+}
+
+template <typename T>
+T& TripleBuffer<T>::back()
+{
+    return _slots[_back];
+}
+
+template <typename T>
+void TripleBuffer<T>::publish()
+{
+    // The release ordering makes the writes to the slot visible to the
+    // reader that acquires it.
+
+    unsigned old = _middle.exchange(_back | NewBit, std::memory_order_acq_rel);
+    _back = old & IndexMask;
+}
+
+template <typename T>
+bool TripleBuffer<T>::update()
+{
+    if (!(_middle.load(std::memory_order_relaxed) & NewBit))
+        return false;
+
+    unsigned old = _middle.exchange(_front, std::memory_order_acq_rel);
+    _front = old & IndexMask;
+    return true;
+}
+
+template <typename T>
+T& TripleBuffer<T>::front()
+{
+    return _slots[_front];
+}
+
+template <typename T>
+const T& TripleBuffer<T>::front() const
+{
+    return _slots[_front];
+}
+
+#endif
@@ -25,8 +25,16 @@
 //
 
 #import <Cocoa/Cocoa.h>
+#import "FacetiousRegression.h"
 
 int main(int argc, char *argv[])
 {
+    // Setting FACETIOUS_REGRESSION to a directory of golden images runs the
+    // offscreen regression test instead of the application.
+    
+    const char* goldenDir = getenv("FACETIOUS_REGRESSION");
+    if (goldenDir)
+        return facetiousRegression(goldenDir);
+    
     return NSApplicationMain(argc, (const char **)argv);
 }
@@ -0,0 +1,792 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// FacetiousBenchmark.cpp
+//
+// Micro-benchmarks for the Facetious image and animation kernels, runnable
+// without Cocoa or OpenGL:
+//
+// "downsample": the single-pass Downsampler and the iterative reduction by
+// factors of two (Agl::reduceImageBy2) that it replaced, reducing face
+// regions of frames from 480p to 4K to 64 pixels wide.
+//
+// "pool": taking and returning slabs of the FixedImagePool.
+//
+// "face": FramePipeline::largestFace(), choosing among detected faces.
+//
+// "average": the Aut::RunningAverage updates that stabilized the face,
+// and the Stabilizer that replaced them with each of its filters, with
+// the jitter and lag of each on a synthetic track of a face.
+//
+// "anim": Animation<float>::eval() and StaticAnimation::eval() with the
+// application's animation, driven by a fixed-step AnimationClock so every
+// run evaluates the same times, alone and into a published AnimationState
+// snapshot, and StaticAnimation::evalBatch() for many animations at once.
+// It checks that the static animation matches the run-time one.
+//
+// "heightfield": the CPU versions of the height-field warp done by
+// LuminanceHeightFieldVertexShader, and the height map that replaced its
+// texture samples.  It checks that the fast versions match the reference
+// within a tolerance; the exit status is nonzero if they do not.
+//
+// Each benchmark reports the time per operation, the bytes processed per
+// second where that is meaningful, and the heap allocations per operation,
+// counted by replacing the global operator new.  Give the names of
+// benchmarks as arguments to run only those, "--min-time S" to time each
+// case for at least S seconds (default 0.5), and "--json FILE" to also
+// write the results to FILE, to compare across commits.
+//
+
+#include "FacetiousAnimation.h"
+#include "FacetiousDownsample.h"
+#include "FacetiousFramePipeline.h"
+#include "FacetiousHeightField.h"
+#include "FacetiousImagePool.h"
+#include "FacetiousStabilizer.h"
+#include "FacetiousStaticAnimation.h"
+#include "FacetiousTripleBuffer.h"
+
+#include "AutRunningAverage.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <math.h>
+#include <stdint.h>
+
+namespace
+{
+    // The number of calls to the global operator new since the start.
+
+    std::atomic<uint64_t> allocationCount(0);
+}
+
+void* operator new(size_t size)
+{
+    ++allocationCount;
+    if (void* p = malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+namespace
+{
+    const int bytesPerPixel = 4;
+
+    typedef std::chrono::steady_clock Clock;
+
+    // The same computation as Agl::reduceImageBy2(), copied here because
+    // Agl depends on OpenGL.
+
+    void reduceImageBy2(uint8_t* dst, const uint8_t* src, int width, int height,
+                        int rowLength, int x, int y)
+    {
+        int dstWidth = width / 2;
+        int dstHeight = height / 2;
+        for (int j = 0; j < dstHeight; ++j)
+        {
+            const uint8_t* src0 = src + ((y + 2 * j) * rowLength + x) * bytesPerPixel;
+            const uint8_t* src1 = src0 + rowLength * bytesPerPixel;
+            uint8_t* d = dst + j * dstWidth * bytesPerPixel;
+            for (int i = 0; i < dstWidth; ++i)
+            {
+                for (int c = 0; c < bytesPerPixel; ++c)
+                {
+                    int sum = src0[c] + src0[bytesPerPixel + c] +
+                        src1[c] + src1[bytesPerPixel + c];
+                    d[c] = uint8_t(sum / 4);
+                }
+                src0 += 2 * bytesPerPixel;
+                src1 += 2 * bytesPerPixel;
+                d += bytesPerPixel;
+            }
+        }
+    }
+
+    // The reduction loop as it was in detectorThreadFunc(), with a pool
+    // buffer taken for each halving.  Returns the buffer holding the result
+    // and sets "width" and "height" to its size.
+
+    uint8_t* reduceIteratively(std::vector<uint8_t*>& pool, size_t imageBytes,
+                               const uint8_t* image, int imageWidth,
+                               int x, int y, int& width, int& height,
+                               int widthMax)
+    {
+        const uint8_t* src = image;
+        uint8_t* dst = 0;
+        int rowLength = imageWidth;
+        while (width > widthMax)
+        {
+            width -= width % 2;
+            uint8_t* next;
+            if (pool.empty())
+            {
+                next = new uint8_t [imageBytes];
+            }
+            else
+            {
+                next = pool.back();
+                pool.pop_back();
+            }
+
+            reduceImageBy2(next, src, width, height, rowLength, x, y);
+
+            width /= 2;
+            height /= 2;
+            rowLength = width;
+            x = y = 0;
+
+            if (dst)
+                pool.push_back(dst);
+            dst = next;
+            src = dst;
+        }
+        return dst;
+    }
+
+    // The cost of one operation, averaged over many.
+
+    struct Measurement
+    {
+        double          ns;
+        double          allocations;
+    };
+
+    double minSeconds = 0.5;
+
+    // Results are added to this so the compiler cannot discard the work
+    // that computed them.
+
+    volatile size_t consumed = 0;
+
+    // Calls "f" repeatedly for at least "minSeconds", after one untimed
+    // call to warm up, and returns the mean time and allocations per call.
+
+    template <typename F>
+    Measurement timeIt(F f)
+    {
+        f();
+        long n = 0;
+        uint64_t allocationsStart = allocationCount;
+        Clock::time_point start = Clock::now();
+        Clock::duration elapsed;
+        do
+        {
+            for (int i = 0; i < 10; ++i)
+                f();
+            n += 10;
+            elapsed = Clock::now() - start;
+        }
+        while (elapsed < std::chrono::duration<double>(minSeconds));
+        uint64_t allocations = allocationCount - allocationsStart;
+
+        Measurement m;
+        m.ns = std::chrono::duration_cast<std::chrono::duration<double, std::nano> >(elapsed).count() / n;
+        m.allocations = double(allocations) / n;
+        return m;
+    }
+
+    // A result, for the report and the JSON file.  A "bytes" of 0 means
+    // throughput is not meaningful for the benchmark.
+
+    struct Result
+    {
+        std::string     benchmark;
+        std::string     name;
+        std::string     variant;
+        double          ns;
+        double          bytes;
+        double          allocations;
+    };
+
+    std::vector<Result> results;
+
+    void report(const std::string& benchmark, const std::string& name,
+                const std::string& variant, const Measurement& m,
+                double bytes = 0)
+    {
+        Result r;
+        r.benchmark = benchmark;
+        r.name = name;
+        r.variant = variant;
+        r.ns = m.ns;
+        r.bytes = bytes;
+        r.allocations = m.allocations;
+        results.push_back(r);
+
+        std::cout << std::left << std::setw(28) << name << std::setw(28) << variant
+                  << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(12) << m.ns << " ns/op";
+        if (bytes > 0)
+            std::cout << std::setw(10) << bytes / m.ns << " GB/s";
+        else
+            std::cout << std::setw(15) << "";
+        std::cout << std::setprecision(2) << std::setw(8) << m.allocations
+                  << " allocs/op\n";
+        std::cout.unsetf(std::ios::floatfield);
+    }
+
+    std::string size(int w, int h)
+    {
+        std::ostringstream s;
+        s << w << "x" << h;
+        return s.str();
+    }
+
+    void benchmarkDownsample()
+    {
+        std::cout << "Downsampler instruction set: "
+                  << Downsampler::instructionSet() << "\n";
+
+        const int sizes[][2] = { { 640, 480 }, { 1280, 720 }, { 1920, 1080 },
+                                 { 3840, 2160 } };
+        const int widthMax = 64;
+        for (const int* frameSize : sizes)
+        {
+            const int w = frameSize[0], h = frameSize[1];
+            const size_t imageBytes = size_t(w) * h * bytesPerPixel;
+            std::vector<uint8_t> image(imageBytes);
+            for (size_t i = 0; i < imageBytes; ++i)
+                image[i] = uint8_t(rand());
+
+            // A typical face region, a region whose ratio to the target
+            // width is not a power of two, and the whole frame height.
+
+            const int regionSizes[] = { h / 2, 300, h };
+            for (int regionSize : regionSizes)
+            {
+                const int x = (w - regionSize) / 2;
+                const int y = (h - regionSize) / 2;
+                double regionBytes = double(regionSize) * regionSize * bytesPerPixel;
+                std::string variant = size(w, h) + " region " + size(regionSize, regionSize);
+
+                std::vector<uint8_t*> pool;
+                Measurement iterative = timeIt([&] {
+                    int width = regionSize, height = regionSize;
+                    uint8_t* result = reduceIteratively(pool, imageBytes, &image[0], w,
+                                                        x, y, width, height, widthMax);
+                    pool.push_back(result);
+                });
+                for (uint8_t* p : pool)
+                    delete [] p;
+                report("downsample", "iterative reduceBy2", variant, iterative,
+                       regionBytes);
+
+                Downsampler downsampler;
+                std::vector<uint8_t> dst(widthMax * widthMax * bytesPerPixel);
+                Measurement singlePass = timeIt([&] {
+                    downsampler.downsample(&dst[0], widthMax, widthMax, &image[0], w,
+                                           x, y, regionSize, regionSize);
+                });
+                report("downsample", "single-pass Downsampler", variant, singlePass,
+                       regionBytes);
+            }
+        }
+    }
+
+    void benchmarkPool()
+    {
+        // Slabs for 1080p frames, as FramePipeline allocates by default.
+
+        FixedImagePool pool(size_t(1920) * 1080 * bytesPerPixel, 4);
+
+        Measurement one = timeIt([&] {
+            for (int i = 0; i < 100; ++i)
+            {
+                FixedImagePool::Handle handle = pool.alloc();
+                handle.reset();
+            }
+        });
+        one.ns /= 100;
+        one.allocations /= 100;
+        report("pool", "FixedImagePool", "alloc and free", one);
+
+        // Taking every slab, so the last alloc() fails, as when the workers
+        // fall behind.
+
+        std::vector<FixedImagePool::Handle> handles(pool.slabCount() + 1);
+        Measurement all = timeIt([&] {
+            for (FixedImagePool::Handle& handle : handles)
+                handle = pool.alloc();
+            for (FixedImagePool::Handle& handle : handles)
+                handle.reset();
+        });
+        report("pool", "FixedImagePool", "exhaust and free", all);
+    }
+
+    void benchmarkFace()
+    {
+        const int counts[] = { 1, 4, 16 };
+        for (int count : counts)
+        {
+            std::vector<FramePipeline::Rect> faces;
+            for (int i = 0; i < count; ++i)
+                faces.push_back(FramePipeline::Rect(rand() % 1000, rand() % 600,
+                                                    50 + rand() % 400,
+                                                    50 + rand() % 400));
+            size_t chosen = 0;
+            Measurement m = timeIt([&] {
+                for (int i = 0; i < 1000; ++i)
+                    chosen += FramePipeline::largestFace(faces);
+            });
+            m.ns /= 1000;
+            m.allocations /= 1000;
+            std::ostringstream variant;
+            variant << count << (count == 1 ? " face" : " faces");
+            report("face", "largestFace", variant.str(), m);
+            consumed = consumed + chosen;
+        }
+    }
+
+    void benchmarkAverage()
+    {
+        // The four averages with which FramePipeline stabilizes the face
+        // rectangle, updated and read for each frame.
+
+        Aut::RunningAverage<int> xAvg, yAvg, widthAvg, heightAvg;
+        int sum = 0;
+        int frame = 0;
+        Measurement m = timeIt([&] {
+            for (int i = 0; i < 1000; ++i, ++frame)
+            {
+                xAvg.add(400 + frame % 7);
+                yAvg.add(200 + frame % 5);
+                widthAvg.add(300 + frame % 3);
+                heightAvg.add(300 + frame % 11);
+                sum += xAvg() + yAvg() + widthAvg() + heightAvg();
+            }
+        });
+        m.ns /= 1000;
+        m.allocations /= 1000;
+        report("average", "RunningAverage<int>", "4 updates and reads", m);
+        consumed = consumed + sum;
+
+        // The Stabilizer that replaced them, with each of its filters, for
+        // the same samples.
+
+        const char* const specs[] = { "average:10", "exponential", "oneeuro" };
+        for (const char* spec : specs)
+        {
+            Stabilizer stabilizer(Stabilizer::parse(spec));
+            float filtered[Stabilizer::Lanes];
+            float total = 0;
+            m = timeIt([&] {
+                for (int i = 0; i < 1000; ++i, ++frame)
+                {
+                    const float sample[Stabilizer::Lanes] =
+                    {
+                        float(400 + frame % 7), float(200 + frame % 5),
+                        float(300 + frame % 3), float(300 + frame % 11)
+                    };
+                    stabilizer.update(sample, frame / 30.0, filtered);
+                    total += filtered[0] + filtered[1] + filtered[2] + filtered[3];
+                }
+            });
+            m.ns /= 1000;
+            m.allocations /= 1000;
+            report("average", "Stabilizer", std::string(spec) + ", 4 lanes", m);
+            consumed = consumed + size_t(total);
+        }
+
+        // How well each filter stabilizes a face that holds still with
+        // jitter of a few pixels from the detector, then moves across the
+        // frame at 300 pixels per second: the RMS of the frame-to-frame
+        // change in the output while the face is still, and the RMS error
+        // from the true position while it moves, which is mostly lag.
+
+        std::cout << "  " << std::setw(26) << std::left << "filter"
+                  << std::setw(18) << "still jitter (px)" << "moving error (px)\n";
+        srand(1);
+        std::vector<float> truth, detected;
+        for (int i = 0; i < 300; ++i)
+        {
+            float x = (i < 150) ? 400.0f : 400.0f + 10.0f * (i - 150);
+            truth.push_back(x);
+            detected.push_back(float(int(x) + rand() % 7 - 3));
+        }
+        for (const char* spec : specs)
+        {
+            Stabilizer stabilizer(Stabilizer::parse(spec));
+            double jitter = 0, error = 0;
+            float previous = 0;
+            for (size_t i = 0; i < truth.size(); ++i)
+            {
+                const float sample[Stabilizer::Lanes] =
+                    { detected[i], detected[i], 300, 300 };
+                float filtered[Stabilizer::Lanes];
+                stabilizer.update(sample, i / 30.0, filtered);
+                if ((i >= 30) && (i < 150))
+                    jitter += double(filtered[0] - previous) * (filtered[0] - previous);
+                else if (i >= 150)
+                    error += double(filtered[0] - truth[i]) * (filtered[0] - truth[i]);
+                previous = filtered[0];
+            }
+            std::cout << "  " << std::setw(26) << spec << std::fixed
+                      << std::setprecision(2) << std::setw(18) << sqrt(jitter / 120)
+                      << sqrt(error / 150) << "\n";
+            std::cout.unsetf(std::ios::floatfield);
+        }
+        std::cout << std::right;
+    }
+
+    // The tolerance for the batched animation to match the scalar one, in
+    // degrees.  The batch works with times in seconds as floats, so it
+    // differs only by rounding.
+
+    const float animBatchTolerance = 1e-3f;
+
+    bool benchmarkAnim()
+    {
+        // The application's animation, rotating left, right and back, then
+        // down, up and back, as built at run time before TurnAndNodAnimation
+        // fixed it at compile time.
+
+        typedef TurnAndNodAnimation::Type Static;
+        const size_t RotAngleX = TurnAndNodAnimation::RotAngleX;
+        const size_t RotAngleY = TurnAndNodAnimation::RotAngleY;
+        const size_t ChannelCount = TurnAndNodAnimation::ChannelCount;
+        std::vector<Animation<float>::Segment> segments;
+        segments.push_back(Animation<float>::Segment(RotAngleY, 0, 50,
+                                                     std::chrono::seconds(5)));
+        segments.push_back(Animation<float>::Segment(RotAngleY, 50, -50,
+                                                     std::chrono::seconds(10)));
+        segments.push_back(Animation<float>::Segment(RotAngleY, -50, 0,
+                                                     std::chrono::seconds(5)));
+        segments.push_back(Animation<float>::Segment(RotAngleX, 0, 50,
+                                                     std::chrono::seconds(5)));
+        segments.push_back(Animation<float>::Segment(RotAngleX, 50, -50,
+                                                     std::chrono::seconds(10)));
+        segments.push_back(Animation<float>::Segment(RotAngleX, -50, 0,
+                                                     std::chrono::seconds(5)));
+
+        Animation<float> anim;
+        anim.set(segments);
+        AnimationClock clock;
+        clock.setFixedStep(std::chrono::milliseconds(33));
+        clock.start();
+        float values[ChannelCount] = { 0, 0 };
+        Measurement m = timeIt([&] {
+            for (int i = 0; i < 1000; ++i)
+                anim.eval(clock.tick(), values);
+        });
+        m.ns /= 1000;
+        m.allocations /= 1000;
+        report("anim", "Animation<float>::eval", "6 segments", m);
+        consumed = consumed + size_t(values[RotAngleX] + values[RotAngleY]);
+
+        m = timeIt([&] {
+            for (int i = 0; i < 1000; ++i)
+                Static::eval(clock.tick(), values);
+        });
+        m.ns /= 1000;
+        m.allocations /= 1000;
+        report("anim", "StaticAnimation::eval", "6 segments", m);
+        consumed = consumed + size_t(values[RotAngleX] + values[RotAngleY]);
+
+        // Evaluating into the snapshot the application publishes to the
+        // scheduler's thread, with the reader taking each one.
+
+        TripleBuffer<AnimationState<float, ChannelCount> > published;
+        m = timeIt([&] {
+            for (int i = 0; i < 1000; ++i)
+            {
+                AnimationState<float, ChannelCount>& state = published.back();
+                state.running = clock.running();
+                state.time = clock.tick();
+                Static::eval(state.time, state.values.data());
+                published.publish();
+                published.update();
+            }
+        });
+        m.ns /= 1000;
+        m.allocations /= 1000;
+        report("anim", "StaticAnimation::eval", "6 segments, published", m);
+        consumed = consumed + size_t(published.front().values[RotAngleX]);
+
+        // The static animation must give exactly the values of the run-time
+        // one, over more than one pass and at negative times.
+
+        bool ok = true;
+        for (int ms = -45000; ms <= 85000; ms += 7)
+        {
+            AnimationClock::Duration t = std::chrono::milliseconds(ms);
+            float expected[ChannelCount] = { 0, 0 };
+            float actual[ChannelCount] = { 0, 0 };
+            anim.eval(t, expected);
+            Static::eval(t, actual);
+            if ((expected[RotAngleX] != actual[RotAngleX]) ||
+                (expected[RotAngleY] != actual[RotAngleY]))
+            {
+                ok = false;
+            }
+        }
+        if (!ok)
+            std::cout << "  StaticAnimation::eval MISMATCH\n";
+
+        // Many independent animations, as for many faces, each at its own
+        // phase, evaluated in one batch per frame.
+
+        const size_t faceCounts[] = { 16, 256, 4096 };
+        for (size_t faces : faceCounts)
+        {
+            std::vector<float> times(faces);
+            for (size_t i = 0; i < faces; ++i)
+                times[i] = 0.37f * i;
+            std::vector<float> x(faces), y(faces);
+            float* batchValues[ChannelCount];
+            batchValues[RotAngleX] = &x[0];
+            batchValues[RotAngleY] = &y[0];
+
+            m = timeIt([&] {
+                for (size_t i = 0; i < faces; ++i)
+                    times[i] += 0.033f;
+                Static::evalBatch(&times[0], faces, batchValues);
+            });
+            m.ns /= faces;
+            m.allocations /= faces;
+            std::ostringstream variant;
+            variant << faces << " animations, each";
+            report("anim", "StaticAnimation::evalBatch", variant.str(), m);
+            consumed = consumed + size_t(x[faces / 2] + y[faces - 1]);
+
+            float errorMax = 0;
+            for (size_t i = 0; i < faces; ++i)
+            {
+                AnimationClock::Duration t = std::chrono::duration_cast<AnimationClock::Duration>(std::chrono::duration<double>(times[i]));
+                float expected[ChannelCount] = { 0, 0 };
+                Static::eval(t, expected);
+                errorMax = std::max(errorMax, fabsf(expected[RotAngleX] - x[i]));
+                errorMax = std::max(errorMax, fabsf(expected[RotAngleY] - y[i]));
+            }
+            bool match = (errorMax <= animBatchTolerance);
+            ok = ok && match;
+            std::cout << "  max error " << std::scientific << std::setprecision(1)
+                      << errorMax << " deg" << (match ? "" : "  MISMATCH") << "\n";
+            std::cout.unsetf(std::ios::floatfield);
+        }
+        return ok;
+    }
+
+    // The tolerances for the fast warp to match the reference.  The two
+    // filter the texture in a different order, so they differ only by
+    // rounding.
+
+    const float heightFieldPositionTolerance = 1e-5f;
+    const float heightFieldNormalDegreesTolerance = 0.01f;
+
+    bool benchmarkHeightField()
+    {
+        // A face-sized texture with smooth features and some noise, as from
+        // the detector, and the grid of the front surface.
+
+        const int texSize = 64;
+        const double textureBytes = double(texSize) * texSize * bytesPerPixel;
+        std::vector<uint8_t> texture(texSize * texSize * bytesPerPixel);
+        for (int j = 0; j < texSize; ++j)
+        {
+            for (int i = 0; i < texSize; ++i)
+            {
+                uint8_t* p = &texture[(j * texSize + i) * bytesPerPixel];
+                int base = 128 + int(100 * sin(i * 0.2) * cos(j * 0.15));
+                for (int c = 0; c < 3; ++c)
+                    p[c] = uint8_t(std::max(0, std::min(255, base + rand() % 32 - 16)));
+                p[3] = 255;
+            }
+        }
+
+        HeightField heightField;
+        heightField.setTexture(&texture[0], texSize, texSize);
+        const float texelWidth = 2.0f / texSize;
+
+        bool ok = true;
+        const int resolutions[] = { 64, 256, 512 };
+        for (int res : resolutions)
+        {
+            HeightField::Vertices grid, reference, fast;
+            HeightField::makeGrid(res, res, grid);
+
+            Measurement mReference = timeIt([&] {
+                heightField.warpReference(grid, texelWidth, texelWidth, reference);
+            });
+            Measurement mFast = timeIt([&] {
+                heightField.warp(grid, texelWidth, texelWidth, fast);
+            });
+            report("heightfield", "warp reference", size(res, res) + " grid", mReference);
+            report("heightfield", "warp", size(res, res) + " grid", mFast);
+
+            HeightField::Difference d = HeightField::compare(reference, fast);
+            bool match = (d.positionMax <= heightFieldPositionTolerance) &&
+                (d.normalDegreesMax <= heightFieldNormalDegreesTolerance);
+            ok = ok && match;
+
+            double vertices = double(res) * res;
+            std::cout << "  " << std::fixed << std::setprecision(2)
+                      << mReference.ns / vertices << " vs " << mFast.ns / vertices
+                      << " ns/vertex (" << std::setprecision(1)
+                      << mReference.ns / mFast.ns << "x)"
+                      << std::scientific << std::setprecision(1)
+                      << ", max error " << d.positionMax << ", "
+                      << d.normalDegreesMax << " deg"
+                      << (match ? "" : "  MISMATCH") << "\n";
+            std::cout.unsetf(std::ios::floatfield);
+        }
+
+        // The height map that replaces the shader's three texture samples
+        // must give the same heights away from the edges, where the edge
+        // weight is 1.
+
+        std::vector<float> map;
+        Measurement mMap = timeIt([&] {
+            HeightField::makeHeightMap(&texture[0], texSize, texSize, texSize, map);
+        });
+        report("heightfield", "height map", size(texSize, texSize) + " texture", mMap,
+               textureBytes);
+
+        HeightField::Vertices grid, reference;
+        HeightField::makeGrid(512, 512, grid);
+        heightField.setHeightScale(1);
+        heightField.warpReference(grid, texelWidth, texelWidth, reference);
+
+        float mapErrorMax = 0;
+        double mapAngleMax = 0;
+        for (size_t k = 0; k < grid.size(); ++k)
+        {
+            float s = grid.s[k], t = grid.t[k];
+            if ((s < 0.1f) || (s > 0.9f) || (t < 0.1f) || (t > 0.9f))
+                continue;
+
+            // Filter the map as the GPU would, and compute the normal as
+            // the slimmer shader does.
+
+            float u = s * texSize - 0.5f, v = t * texSize - 0.5f;
+            int i = int(u), j = int(v);
+            float fu = u - i, fv = v - j;
+            const float* m00 = &map[(j * texSize + i) * 3];
+            const float* m10 = m00 + 3;
+            const float* m01 = m00 + texSize * 3;
+            const float* m11 = m01 + 3;
+            float h[3];
+            for (int c = 0; c < 3; ++c)
+            {
+                float below = m00[c] + fu * (m10[c] - m00[c]);
+                float above = m01[c] + fu * (m11[c] - m01[c]);
+                h[c] = below + fv * (above - below);
+            }
+            mapErrorMax = std::max(mapErrorMax, fabsf(h[0] - reference.z[k]));
+
+            double nx = -(h[1] - h[0]) * texelWidth;
+            double ny = -(h[2] - h[0]) * texelWidth;
+            double nz = texelWidth * texelWidth;
+            double rx = reference.nx[k], ry = reference.ny[k], rz = reference.nz[k];
+            double cx = ny * rz - nz * ry, cy = nz * rx - nx * rz, cz = nx * ry - ny * rx;
+            double angle = atan2(sqrt(cx * cx + cy * cy + cz * cz),
+                                 nx * rx + ny * ry + nz * rz);
+            mapAngleMax = std::max(mapAngleMax, angle * 180 / M_PI);
+        }
+        bool mapMatch = (mapErrorMax <= heightFieldPositionTolerance) &&
+            (mapAngleMax <= heightFieldNormalDegreesTolerance);
+        ok = ok && mapMatch;
+        std::cout << "  " << std::scientific << std::setprecision(1)
+                  << "max error " << mapErrorMax << ", " << mapAngleMax << " deg"
+                  << (mapMatch ? "" : "  MISMATCH") << "\n";
+        std::cout.unsetf(std::ios::floatfield);
+        return ok;
+    }
+
+    // Write the results as JSON, with enough about the build to tell runs
+    // apart.
+
+    bool writeJson(const std::string& path)
+    {
+        std::ofstream out(path.c_str());
+        out << "{\"instructionSet\":\"" << Downsampler::instructionSet()
+            << "\",\"results\":[";
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            const Result& r = results[i];
+            out << (i ? ",\n" : "\n")
+                << "{\"benchmark\":\"" << r.benchmark << "\",\"name\":\"" << r.name
+                << "\",\"variant\":\"" << r.variant << "\",\"nsPerOp\":" << r.ns
+                << ",\"bytesPerSecond\":" << (r.bytes > 0 ? r.bytes / r.ns * 1e9 : 0)
+                << ",\"allocationsPerOp\":" << r.allocations << "}";
+        }
+        out << "\n]}\n";
+        return bool(out);
+    }
+
+    bool selected(const std::vector<std::string>& names, const char* name)
+    {
+        return names.empty() ||
+            (std::find(names.begin(), names.end(), name) != names.end());
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    std::vector<std::string> names;
+    std::string jsonPath;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg(argv[i]);
+        if ((arg == "--json") && (i + 1 < argc))
+            jsonPath = argv[++i];
+        else if ((arg == "--min-time") && (i + 1 < argc))
+            minSeconds = atof(argv[++i]);
+        else
+            names.push_back(arg);
+    }
+
+    bool ok = true;
+    if (selected(names, "downsample"))
+        benchmarkDownsample();
+    if (selected(names, "pool"))
+        benchmarkPool();
+    if (selected(names, "face"))
+        benchmarkFace();
+    if (selected(names, "average"))
+        benchmarkAverage();
+    if (selected(names, "anim"))
+        ok = benchmarkAnim() && ok;
+    if (selected(names, "heightfield"))
+        ok = benchmarkHeightField() && ok;
+
+    if (!jsonPath.empty() && !writeJson(jsonPath))
+    {
+        std::cerr << "could not write " << jsonPath << "\n";
+        ok = false;
+    }
+    return ok ? 0 : 1;
+}
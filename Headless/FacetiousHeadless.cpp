@@ -0,0 +1,469 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// FacetiousHeadless.cpp
+//
+// A command-line driver that runs the FramePipeline with synthetic frames,
+// a synthetic detector and a sink that only copies and counts face images.
+// It needs no camera, GPU or Cocoa, so the pipeline's throughput and
+// latency can be measured on any platform.  Run with "--help" for options.
+//
+// With "--scaling N", it runs the pipeline with 1 to N detector workers in
+// turn and reports the rate of face updates for each.
+//
+// With "--stress-handoff", it instead hammers both ends of the TripleBuffer
+// that hands face images to the rendering thread, checking that every value
+// the reader takes is complete and newer than the last.
+//
+
+#include "FacetiousFramePipeline.h"
+#include "FacetiousFrameScheduler.h"
+#include "FacetiousHeadlessSupport.h"
+#include "FacetiousImagePool.h"
+#include "FacetiousRegionDetector.h"
+#include "FacetiousStats.h"
+#include "FacetiousSyntheticSource.h"
+#include "FacetiousTrace.h"
+#include "FacetiousTripleBuffer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <stdlib.h>
+#include <string.h>
+
+namespace
+{
+    struct Options
+    {
+        Options() : width(1280), height(720), seconds(5.0), fps(30.0),
+            renderFps(60.0), detectorCostUs(0), detectorCostPerMpUs(0),
+            detectorImageWidthMax(64),
+            workers(1), scaling(0), detectionInterval(1),
+            trackingConfidenceMin(0.5f), detectionWidthMax(0), stabilize(true),
+            directPixels(true), statsInterval(-1), stressHandoff(false) {}
+        std::string source;
+        int         width;
+        int         height;
+        double      seconds;
+        double      fps;
+        double      renderFps;
+        int         detectorCostUs;
+        int         detectorCostPerMpUs;
+        int         detectorImageWidthMax;
+        int         workers;
+        int         scaling;
+        int         detectionInterval;
+        float       trackingConfidenceMin;
+        int         detectionWidthMax;
+        bool        stabilize;
+        Stabilizer::Settings stabilizer;
+        bool        directPixels;
+        double      statsInterval;
+        std::string tracePath;
+        bool        stressHandoff;
+    };
+
+    void usage(const char* program)
+    {
+        std::cerr << "usage: " << program << " [options]\n"
+            << "  --source SPEC      a SyntheticSource specification, like\n"
+            << "                     file:PATH:WxH@FPS (default procedural)\n"
+            << "  --size W H         procedural frame size (default 1280 720)\n"
+            << "  --fps F            procedural frames per second, or 0 for\n"
+            << "                     as fast as possible (default 30)\n"
+            << "  --seconds S        duration of the run (default 5)\n"
+            << "  --render-fps F     rate of deliver() calls (default 60)\n"
+            << "  --detector-cost U  extra microseconds per detection (default 0)\n"
+            << "  --detector-cost-mp U  extra microseconds per megapixel detected\n"
+            << "                     (default 0)\n"
+            << "  --width-max N      detectorImageWidthMax (default 64)\n"
+            << "  --workers N        detector worker threads (default 1)\n"
+            << "  --scaling N        compare runs with 1 to N workers\n"
+            << "  --detect-every N   full detection every N frames, tracking\n"
+            << "                     in between (default 1, no tracking)\n"
+            << "  --track-confidence C  minimum tracking confidence (default 0.5)\n"
+            << "  --detect-width N   detect in a region of interest reduced to\n"
+            << "                     at most N pixels wide (default 0, off)\n"
+            << "  --no-stabilize     turn off stabilization of the face\n"
+            << "  --stabilizer SPEC  the stabilizer's filter: average:WINDOW,\n"
+            << "                     exponential:SMOOTHING or\n"
+            << "                     oneeuro:MINCUTOFF,BETA[,DCUTOFF] (default oneeuro)\n"
+            << "  --convert          convert the face region before reducing\n"
+            << "                     it, rather than reading frames directly\n"
+            << "  --stats            print per-stage latency histograms at the end\n"
+            << "  --stats-interval S also print them every S seconds\n"
+            << "  --trace FILE       write a Chrome trace of every frame to FILE\n"
+            << "  --stress-handoff   stress test the TripleBuffer instead\n";
+    }
+
+    bool parse(int argc, char* argv[], Options& options)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg(argv[i]);
+            bool hasValue = (i + 1 < argc);
+            if ((arg == "--source") && hasValue)
+                options.source = argv[++i];
+            else if ((arg == "--size") && (i + 2 < argc))
+            {
+                options.width = atoi(argv[++i]);
+                options.height = atoi(argv[++i]);
+            }
+            else if ((arg == "--seconds") && hasValue)
+                options.seconds = atof(argv[++i]);
+            else if ((arg == "--fps") && hasValue)
+                options.fps = atof(argv[++i]);
+            else if ((arg == "--render-fps") && hasValue)
+                options.renderFps = atof(argv[++i]);
+            else if ((arg == "--detector-cost") && hasValue)
+                options.detectorCostUs = atoi(argv[++i]);
+            else if ((arg == "--detector-cost-mp") && hasValue)
+                options.detectorCostPerMpUs = atoi(argv[++i]);
+            else if ((arg == "--width-max") && hasValue)
+                options.detectorImageWidthMax = atoi(argv[++i]);
+            else if ((arg == "--workers") && hasValue)
+                options.workers = atoi(argv[++i]);
+            else if ((arg == "--scaling") && hasValue)
+                options.scaling = atoi(argv[++i]);
+            else if ((arg == "--detect-every") && hasValue)
+                options.detectionInterval = atoi(argv[++i]);
+            else if ((arg == "--track-confidence") && hasValue)
+                options.trackingConfidenceMin = float(atof(argv[++i]));
+            else if ((arg == "--detect-width") && hasValue)
+                options.detectionWidthMax = atoi(argv[++i]);
+            else if (arg == "--no-stabilize")
+                options.stabilize = false;
+            else if ((arg == "--stabilizer") && hasValue)
+            {
+                try
+                {
+                    options.stabilizer = Stabilizer::parse(argv[++i]);
+                }
+                catch (const std::exception& exc)
+                {
+                    std::cerr << exc.what() << "\n";
+                    return false;
+                }
+            }
+            else if (arg == "--convert")
+                options.directPixels = false;
+            else if (arg == "--stats")
+                options.statsInterval = std::max(0.0, options.statsInterval);
+            else if ((arg == "--stats-interval") && hasValue)
+                options.statsInterval = std::max(0.0, atof(argv[++i]));
+            else if ((arg == "--trace") && hasValue)
+                options.tracePath = argv[++i];
+            else if (arg == "--stress-handoff")
+                options.stressHandoff = true;
+            else
+                return false;
+        }
+        return (options.width > 0) && (options.height > 0) &&
+            (options.seconds > 0) && (options.renderFps > 0) &&
+            (options.workers > 0) && (options.scaling >= 0);
+    }
+
+    // A value whose size and contents are determined by its sequence
+    // number, so the reader can tell whether it is complete.
+
+    struct StressValue
+    {
+        StressValue() : sequence(0) {}
+        uint64_t              sequence;
+        std::vector<uint32_t> payload;
+    };
+
+    size_t stressPayloadSize(uint64_t sequence)
+    {
+        return 1 + (sequence * 7919) % 4096;
+    }
+
+    uint32_t stressPayloadWord(uint64_t sequence, size_t i)
+    {
+        return uint32_t(sequence * 2654435761u) ^ uint32_t(i);
+    }
+
+    bool stressHandoff(double seconds)
+    {
+        typedef FramePipeline::Clock Clock;
+        TripleBuffer<StressValue> buffer;
+        std::atomic<bool> done(false);
+        std::atomic<uint64_t> published(0);
+
+        // The writer publishes values as fast as it can, resizing the
+        // payload each time.
+
+        std::thread writer([&] {
+            uint64_t sequence = 0;
+            while (!done)
+            {
+                StressValue& v = buffer.back();
+                v.sequence = ++sequence;
+                v.payload.resize(stressPayloadSize(sequence));
+                for (size_t i = 0; i < v.payload.size(); ++i)
+                    v.payload[i] = stressPayloadWord(sequence, i);
+                buffer.publish();
+                published = sequence;
+            }
+        });
+
+        // The reader takes values as fast as it can, checking each one.
+
+        uint64_t taken = 0, errors = 0, lastSequence = 0;
+        Clock::time_point end = Clock::now() +
+            std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+        while (Clock::now() < end)
+        {
+            if (!buffer.update())
+                continue;
+
+            const StressValue& v = buffer.front();
+            bool ok = (v.sequence > lastSequence) &&
+                (v.payload.size() == stressPayloadSize(v.sequence));
+            for (size_t i = 0; ok && (i < v.payload.size()); ++i)
+                ok = (v.payload[i] == stressPayloadWord(v.sequence, i));
+            if (!ok)
+                ++errors;
+            lastSequence = v.sequence;
+            ++taken;
+        }
+
+        done = true;
+        writer.join();
+
+        std::cout << "values published: " << published << "\n"
+                  << "values taken:     " << taken << "\n"
+                  << "errors:           " << errors << "\n";
+        return (errors == 0) && (taken > 0);
+    }
+
+    // The results of one run of the pipeline.
+
+    struct Run
+    {
+        long                  submitted;
+        uint64_t              processed;
+        uint64_t              tracked;
+        uint64_t              skipped;
+        uint64_t              stale;
+        uint64_t              converted;
+        uint64_t              notConverted;
+        size_t                slabCount;
+        size_t                slabBytes;
+        size_t                highWaterMark;
+        uint64_t              allocationFailures;
+        CountingSink::Totals  totals;
+        FrameScheduler::Stats render;
+        double                elapsed;
+    };
+
+    bool runPipeline(const Options& options, int workers, Run& run)
+    {
+        std::unique_ptr<SyntheticSource> source;
+        try
+        {
+            if (options.source.empty())
+                source.reset(new SyntheticSource(options.width, options.height,
+                                                 options.fps));
+            else
+                source.reset(SyntheticSource::create(options.source));
+        }
+        catch (const std::exception& exc)
+        {
+            std::cerr << exc.what() << "\n";
+            return false;
+        }
+
+        std::chrono::microseconds detectorCost(options.detectorCostUs);
+        std::chrono::microseconds detectorCostPerMp(options.detectorCostPerMpUs);
+        int detectionWidthMax = options.detectionWidthMax;
+        CountingSink sink;
+        FramePipeline pipeline(&sink, [=] () -> FramePipeline::Detector* {
+            FramePipeline::Detector* detector =
+                new SyntheticFaceDetector(128, detectorCost, detectorCostPerMp);
+            if (detectionWidthMax > 0)
+                detector = new RegionDetector(detector, detectionWidthMax);
+            return detector; },
+            source->width(), source->height(), workers);
+        pipeline.setDetectorImageWidthMax(options.detectorImageWidthMax);
+        pipeline.setStabilize(options.stabilize);
+        pipeline.setStabilizer(options.stabilizer);
+        pipeline.setDirectPixels(options.directPixels);
+        pipeline.setDetectionInterval(options.detectionInterval);
+        pipeline.setTrackingConfidenceMin(options.trackingConfidenceMin);
+
+        std::unique_ptr<FrameTrace> trace;
+        if (!options.tracePath.empty())
+            trace.reset(new FrameTrace);
+        pipeline.setTrace(trace.get());
+        sink.setStats(&pipeline.stats(), trace.get());
+        pipeline.start();
+
+        typedef FramePipeline::Clock Clock;
+        Clock::time_point start = Clock::now();
+        Clock::time_point end = start +
+            std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.seconds));
+
+        source->start(&pipeline);
+
+        // The scheduler's thread plays the role of the rendering thread,
+        // delivering at every frame as if the animation were running.
+
+        FrameScheduler scheduler([&pipeline] () { pipeline.deliver(); },
+                                 [] () { return true; }, options.renderFps);
+        scheduler.start();
+        if (options.statsInterval > 0)
+        {
+            Clock::duration interval =
+                std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.statsInterval));
+            for (Clock::time_point t = start + interval; t < end; t += interval)
+            {
+                std::this_thread::sleep_until(t);
+                pipeline.stats().dump(std::cout);
+                std::cout << "\n";
+            }
+        }
+        std::this_thread::sleep_until(end);
+        scheduler.stop();
+        run.render = scheduler.stats();
+
+        source->stop();
+        run.submitted = source->framesSubmitted();
+        run.elapsed =
+            std::chrono::duration_cast<std::chrono::duration<double> >(Clock::now() - start).count();
+        run.totals = sink.totals();
+        run.processed = pipeline.framesProcessed();
+        run.tracked = pipeline.framesTracked();
+        run.skipped = pipeline.framesSkipped();
+        run.stale = pipeline.framesStale();
+        run.converted = pipeline.bytesConverted();
+        run.notConverted = pipeline.bytesNotConverted();
+        if (options.statsInterval >= 0)
+            pipeline.stats().dump(std::cout);
+        const FixedImagePool& pool = pipeline.imagePool();
+        run.slabCount = pool.slabCount();
+        run.slabBytes = pool.slabBytes();
+        run.highWaterMark = pool.highWaterMark();
+        run.allocationFailures = pool.allocationFailures();
+
+        pipeline.stop();
+
+        if (trace)
+        {
+            std::ofstream out(options.tracePath.c_str());
+            trace->writeChromeTrace(out);
+            if (!out)
+            {
+                std::cerr << "could not write the trace to "
+                          << options.tracePath << "\n";
+                return false;
+            }
+            std::cout << "trace events:         " << trace->size()
+                      << " (" << trace->eventsLost() << " lost)\n";
+        }
+        return true;
+    }
+
+    void report(const Run& run, int workers)
+    {
+        double elapsed = run.elapsed;
+        const CountingSink::Totals& totals = run.totals;
+        std::cout << "detector workers:     " << workers << "\n"
+                  << "frames submitted:     " << run.submitted << " ("
+                  << run.submitted / elapsed << " /s)\n"
+                  << "face images published: " << totals.published << " ("
+                  << totals.published / elapsed << " /s)\n"
+                  << "frames processed:     " << run.processed << " ("
+                  << run.processed / elapsed << " /s, " << run.tracked
+                  << " tracked)\n"
+                  << "frames skipped:       " << run.skipped << "\n"
+                  << "frames stale:         " << run.stale << "\n"
+                  << "pool slabs:           " << run.slabCount << " of "
+                  << run.slabBytes << " bytes, high-water mark "
+                  << run.highWaterMark << ", allocation failures "
+                  << run.allocationFailures << "\n"
+                  << "bytes converted:      "
+                  << (run.processed ? run.converted / run.processed : 0)
+                  << " per frame (" << run.converted / elapsed / 1e6
+                  << " MB/s)\n"
+                  << "bytes not converted:  "
+                  << (run.processed ? run.notConverted / run.processed : 0)
+                  << " per frame, read directly from the frames\n"
+                  << "face images delivered: " << totals.delivered << " ("
+                  << totals.delivered / elapsed << " /s, "
+                  << totals.bytesDelivered / elapsed / 1e6 << " MB/s)\n"
+                  << "latency submit->deliver: mean " << totals.latencyMeanUs
+                  << " us, max " << totals.latencyMaxUs << " us\n"
+                  << "render frames:        " << run.render.frames << " ("
+                  << run.render.frames / elapsed << " /s), deadlines missed "
+                  << run.render.deadlinesMissed << ", lateness mean "
+                  << run.render.latenessMeanUs << " us, max "
+                  << run.render.latenessMaxUs << " us\n";
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parse(argc, argv, options))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (options.stressHandoff)
+        return stressHandoff(options.seconds) ? 0 : 1;
+
+    if (options.scaling == 0)
+    {
+        Run run;
+        if (!runPipeline(options, options.workers, run))
+            return 1;
+        report(run, options.workers);
+        return 0;
+    }
+
+    // Compare the rate of face updates with increasing numbers of workers.
+    // The detector cost should be well above the frame period for the
+    // extra workers to have anything to do.
+
+    std::cout << "workers  processed/s  published/s  stale  latency (us)\n";
+    for (int workers = 1; workers <= options.scaling; ++workers)
+    {
+        Run run;
+        if (!runPipeline(options, workers, run))
+            return 1;
+        std::cout << std::setw(7) << workers
+                  << std::setw(13) << run.processed / run.elapsed
+                  << std::setw(13) << run.totals.published / run.elapsed
+                  << std::setw(7) << run.stale
+                  << std::setw(14) << run.totals.latencyMeanUs << "\n";
+    }
+    return 0;
+}
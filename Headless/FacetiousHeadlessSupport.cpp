@@ -0,0 +1,151 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+//  FacetiousHeadlessSupport.cpp
+//
+
+#include "FacetiousHeadlessSupport.h"
+#include "FacetiousStats.h"
+#include "FacetiousTrace.h"
+
+#include <algorithm>
+#include <thread>
+#include <string.h>
+
+SyntheticFaceDetector::SyntheticFaceDetector(int threshold,
+                                             std::chrono::microseconds extraCost,
+                                             std::chrono::microseconds extraCostPerMegapixel) :
+    _threshold(threshold), _extraCost(extraCost),
+    _extraCostPerMegapixel(extraCostPerMegapixel)
+{
+}
+
+void SyntheticFaceDetector::detect(const FramePipeline::Frame& frame,
+                                   std::vector<FramePipeline::Rect>& faces)
+{
+    FramePipeline::Clock::time_point start = FramePipeline::Clock::now();
+
+    const FramePipeline::RawFrame& rawFrame =
+        dynamic_cast<const FramePipeline::RawFrame&>(frame);
+    const int width = rawFrame.width();
+    const int height = rawFrame.height();
+    const uint8_t* p = rawFrame.pixels();
+
+    // Compare luminance in fixed point, with the Rec. 709 weights used by
+    // LuminanceHeightFieldVertexShader.
+
+    const int r = (rawFrame.format() == FramePipeline::BGRA) ? 2 : 0;
+    const int b = 2 - r;
+    const int threshold = _threshold * 256;
+    int xMin = width, xMax = -1, yMin = height, yMax = -1;
+    for (int j = 0; j < height; ++j)
+    {
+        for (int i = 0; i < width; ++i, p += 4)
+        {
+            int lum = 54 * p[r] + 183 * p[1] + 19 * p[b];
+            if (lum > threshold)
+            {
+                xMin = std::min(xMin, i);
+                xMax = std::max(xMax, i);
+                yMin = std::min(yMin, j);
+                yMax = std::max(yMax, j);
+            }
+        }
+    }
+
+    if (xMax >= 0)
+    {
+        // The frame's rows are top first, but faces have their origin at
+        // the lower left.
+
+        faces.push_back(FramePipeline::Rect(xMin, height - 1 - yMax,
+                                            xMax - xMin + 1, yMax - yMin + 1));
+    }
+
+    std::chrono::microseconds extraCost = _extraCost +
+        std::chrono::microseconds(int64_t(_extraCostPerMegapixel.count() *
+                                          (double(width) * height / 1e6)));
+    if (extraCost.count() > 0)
+        std::this_thread::sleep_until(start + extraCost);
+}
+
+//
+
+CountingSink::CountingSink() :
+    _published(0), _delivered(0), _bytesDelivered(0), _latencySumUs(0),
+    _latencyMaxUs(0), _stats(0), _trace(0)
+{
+}
+
+void CountingSink::setStats(Stats* stats, FrameTrace* trace)
+{
+    _stats = stats;
+    _trace = trace;
+}
+
+void CountingSink::faceImageReady()
+{
+    ++_published;
+}
+
+void CountingSink::receiveFaceImage(const FramePipeline::FaceImage& image)
+{
+    // Copy the face region, as glTexImage2D would.
+
+    const size_t rowBytes = image.width * 4;
+    _texture.resize(rowBytes * image.height);
+    for (int j = 0; j < image.height; ++j)
+    {
+        const uint8_t* src = image.data +
+            ((image.skipRows + j) * image.rowLength + image.skipPixels) * 4;
+        memcpy(&_texture[j * rowBytes], src, rowBytes);
+    }
+
+    FramePipeline::Clock::time_point now = FramePipeline::Clock::now();
+    FramePipeline::Clock::duration latency = now - image.captureTime;
+    if (_stats)
+        _stats->histogram(Stats::CaptureToDisplay).record(latency);
+    if (_trace)
+        _trace->span(Stats::name(Stats::CaptureToDisplay), image.sequence,
+                     image.captureTime, now);
+    double latencyUs =
+        std::chrono::duration_cast<std::chrono::duration<double, std::micro> >(latency).count();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    ++_delivered;
+    _bytesDelivered += long(_texture.size());
+    _latencySumUs += latencyUs;
+    _latencyMaxUs = std::max(_latencyMaxUs, latencyUs);
+}
+
+CountingSink::Totals CountingSink::totals() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    Totals t;
+    t.published = _published;
+    t.delivered = _delivered;
+    t.bytesDelivered = _bytesDelivered;
+    t.latencyMeanUs = _delivered ? _latencySumUs / _delivered : 0.0;
+    t.latencyMaxUs = _latencyMaxUs;
+    return t;
+}
@@ -0,0 +1,114 @@
+// Copyright (c) 2013 Philip M. Hubbard
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// http://opensource.org/licenses/MIT
+
+//
+// FacetiousHeadlessSupport.h
+//
+// Stand-ins for the camera, the face detector and the texture upload, so
+// the FramePipeline can be run and measured without Cocoa, AVFoundation or
+// OpenGL.
+//
+// SyntheticFaceDetector: A FramePipeline::Detector that finds the bounding
+// box of the bright pixels in a FramePipeline::RawFrame.  Like a real
+// detector, it examines every pixel of the frame, and it can optionally
+// spend extra time per frame, and per pixel, to mimic a slower detector.
+//
+// CountingSink: A FramePipeline::Sink that copies each face image, as a
+// texture upload would, and accumulates counts and latencies.  Optionally
+// it records each delivery as the display of the face image, from capture
+// to display, in the pipeline's Stats and FrameTrace.
+//
+
+#ifndef __FacetiousHeadlessSupport__
+#define __FacetiousHeadlessSupport__
+
+#include "FacetiousFramePipeline.h"
+
+#include <atomic>
+#include <mutex>
+
+class FrameTrace;
+class Stats;
+
+class SyntheticFaceDetector : public FramePipeline::Detector
+{
+public:
+
+    // Pixels with a luminance above "threshold" (0 to 255) are part of the
+    // face.  Each call to detect() takes at least "extraCost" plus
+    // "extraCostPerMegapixel" for each million pixels in the frame.
+
+    SyntheticFaceDetector(int threshold = 128,
+                          std::chrono::microseconds extraCost =
+                              std::chrono::microseconds(0),
+                          std::chrono::microseconds extraCostPerMegapixel =
+                              std::chrono::microseconds(0));
+
+    virtual void    detect(const FramePipeline::Frame& frame,
+                           std::vector<FramePipeline::Rect>& faces);
+
+private:
+    int                       _threshold;
+    std::chrono::microseconds _extraCost;
+    std::chrono::microseconds _extraCostPerMegapixel;
+};
+
+class CountingSink : public FramePipeline::Sink
+{
+public:
+    CountingSink();
+
+    virtual void    faceImageReady();
+    virtual void    receiveFaceImage(const FramePipeline::FaceImage& image);
+
+    // Record capture-to-display latency in "stats", and also in "trace" if
+    // it is not null.  Call before the pipeline starts.
+
+    void            setStats(Stats* stats, FrameTrace* trace = 0);
+
+    // The totals so far.  Latencies are from the submission of a frame to
+    // the delivery of the face image from it, in microseconds.
+
+    struct Totals
+    {
+        long        published;
+        long        delivered;
+        long        bytesDelivered;
+        double      latencyMeanUs;
+        double      latencyMaxUs;
+    };
+
+    Totals          totals() const;
+
+private:
+    std::atomic<long>  _published;
+    mutable std::mutex _mutex;
+    long               _delivered;
+    long               _bytesDelivered;
+    double             _latencySumUs;
+    double             _latencyMaxUs;
+    std::vector<uint8_t> _texture;
+    Stats*             _stats;
+    FrameTrace*        _trace;
+};
+
+#endif